@@ -1,21 +1,46 @@
 #ifndef CAMERA_H_
 #define CAMERA_H_
 #include "common.h"
+#include "glm/glm.hpp"
+#include <array>
 
 struct Camera {
+	Camera();
 
-	// glm matrices, frustum planes
-
+	// 2D: top-left origin, y down, 1 unit per pixel like u_ortho.
+	void setOrtho(glm::vec2 size);
+	void setPerspective(int fov, float aspect, float z_near = 1.0f, float z_far = 1000.0f);
 	void setFoV(int fov);
-	
-	glm::mat4& getMatrix();
-	
-	// rotate, translate e.t.c functions perhaps
-	
-	bool isPointVisible();
-	bool isSphereVisible();
-	bool isBoxVisible();
 
+	void setPosition(glm::vec3 pos);
+	void move(glm::vec3 delta);
+	void lookAt(glm::vec3 target, glm::vec3 up = { 0.0f, 1.0f, 0.0f });
+
+	glm::vec3 getPosition() const { return position; }
+
+	const glm::mat4& getMatrix();     // projection * view
+	const glm::mat4& getViewMatrix();
+
+	bool isPointVisible(glm::vec3 p);
+	bool isSphereVisible(glm::vec3 center, float radius);
+	bool isBoxVisible(glm::vec3 min, glm::vec3 max);
+
+	// bumped whenever the matrices change, so users can skip re-uploading it.
+	uint32_t getVersion() const { return version; }
+
+	// the matrices are recalculated lazily, call this first if several threads will use them.
+	void update();
+
+private:
+
+	glm::mat4 proj, view, view_proj;
+	std::array<glm::vec4, 6> planes;
+
+	glm::vec3 position, forward, up;
+	float aspect, z_near, z_far;
+	int fov;
+	uint32_t version;
+	bool ortho, dirty;
 };
 
 #endif
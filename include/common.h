@@ -45,6 +45,12 @@ struct Material;
 struct VertexBuffer;
 struct Text;
 struct ShaderUniforms;
+struct Camera;
+struct AtlasRegion;
+struct TextureAtlas;
+struct CommandList;
+struct TextureLoader;
+struct JobSystem;
 
 template<class T> struct CVarNumeric;
 using CVarInt = CVarNumeric<int>;
@@ -10,6 +10,7 @@ struct Engine {
 	void quit(void);
 	~Engine();
 
+	std::unique_ptr<JobSystem>       jobs;
 	std::unique_ptr<ResourceSystem>  res;
 	std::unique_ptr<Config>          cfg;
 	std::unique_ptr<Input>           input;
@@ -10,6 +10,8 @@
 #include "renderer/shader.h"
 #include "renderer/renderable.h"
 #include "renderer/texture.h"
+#include "renderer/texture_atlas.h"
+#include "renderer/texture_loader.h"
 #include "renderer/gl_context.h"
 #include "renderer/blend_mode.h"
 #include "renderer/shader_uniforms.h"
@@ -17,12 +19,17 @@
 #include "renderer/material.h"
 #include "renderer/vertex_state.h"
 #include "renderer/sprite.h"
+#include "renderer/tile_map.h"
 #include "renderer/render_state.h"
 #include "renderer/gl_functions.h"
 #include "renderer/vertex_buffer.h"
 #include "renderer/shader_attribs.h"
 #include "renderer/buffer_common.h"
+#include "renderer/uniform_buffer.h"
 #include "renderer/mesh.h"
+#include "renderer/command_list.h"
+#include "renderer/gpu_timer.h"
+#include "renderer/png_writer.h"
 #include "trie.h"
 #include "resource_system.h"
 #include "state_system.h"
@@ -42,6 +49,8 @@
 #include "cli.h"
 #include "engine.h"
 #include "text_system.h"
+#include "job_system.h"
+#include "particle_system.h"
 
 #endif
 
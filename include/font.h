@@ -18,7 +18,17 @@ struct Font : public GLObject {
 	glm::ivec2 getKerning(char32_t a, char32_t b) const;
 	size_t getLineHeight() const;
 	const GlyphInfo& getGlyphInfo(char32_t c) const;
-	const Texture2D* getTexture() const;
+
+	// copies the glyphs into a page of an array TextureAtlas, so text can be drawn
+	// with the same texture binding as the atlas' sprites. false if it didn't fit.
+	bool addToAtlas(TextureAtlas& ta);
+
+	// the TextureAtlas' array once added to one, otherwise the font's own texture.
+	const Texture* getTexture() const;
+	glm::ivec2 getTextureSize() const;
+	uint16_t getLayer() const {
+		return layer;
+	}
 
 private:
 	std::vector<GlyphInfo> glyph_info;
@@ -27,6 +37,12 @@ private:
 	uint16_t utf_lo, utf_hi;
 	FT_Face face;
 	Texture2D atlas;
+
+	std::vector<uint8_t> pixels; // glyph + outline pairs, kept for addToAtlas.
+	glm::ivec2 pixels_size;
+	const Texture2DArray* array;
+	int array_size;
+	uint16_t layer;
 };
 
 #endif
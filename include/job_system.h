@@ -0,0 +1,39 @@
+#ifndef JOB_SYSTEM_H_
+#define JOB_SYSTEM_H_
+#include "common.h"
+#include <SDL.h>
+#include <functional>
+#include <vector>
+#include <deque>
+
+/* Small pool of worker threads for CPU-side work that doesn't touch GL, like image
+   decoding. Jobs run in submission order but may finish in any order; with no
+   worker threads (emscripten) they are run inline by submit(). */
+struct JobSystem {
+	JobSystem(int num_threads = -1);
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	void submit(std::function<void()>&& job);
+
+	// runs fn(0) ... fn(n-1) spread over the workers and the calling thread, and returns
+	// once all of them are done.
+	void parallelFor(size_t n, const std::function<void(size_t)>& fn);
+
+	size_t numThreads() const {
+		return threads.size();
+	}
+
+	~JobSystem();
+private:
+	static int workerMain(void* self);
+
+	std::vector<SDL_Thread*> threads;
+	std::deque<std::function<void()>> queue;
+	SDL_mutex* lock;
+	SDL_cond* cond;
+	SDL_cond* done_cond;
+	bool quit;
+};
+
+#endif
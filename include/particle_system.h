@@ -0,0 +1,110 @@
+#ifndef PARTICLE_SYSTEM_H_
+#define PARTICLE_SYSTEM_H_
+#include "common.h"
+#include "index_buffer.h"
+#include "vertex_buffer.h"
+#include "vertex_state.h"
+#include "renderable.h"
+#include <vector>
+#include <memory>
+#include <functional>
+
+/* Where and how a ParticleSystem spawns particles. Velocities and lifetimes are picked
+   uniformly between their min and max for each particle. */
+struct ParticleEmitter {
+	glm::vec2 pos;
+	glm::vec2 vel_min, vel_max; // pixels per second.
+	float life_min, life_max;   // seconds.
+	float size;
+	uint32_t color;             // 0xRRGGBBAA, the alpha fades out over each particle's life.
+	float rate;                 // particles per second, 0 to only spawn by burst().
+	bool active;
+};
+
+/* Particles for one material, kept as separate arrays per attribute so the update
+   runs over them 4 at a time, split across the JobSystem for large counts. Dead ones
+   are swap-removed, and everything alive is drawn as one instanced quad per particle.
+   Without instancing, each particle is written out as 4 vertices instead, so the same
+   shader works for both, reading its attributes per vertex rather than per instance. */
+struct ParticleSystem {
+	ParticleSystem(Engine& e, Material& m, ShaderProgram& inst_shader, size_t max_particles = 1 << 17);
+	ParticleSystem(const ParticleSystem&) = delete;
+	ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+	// owned by the system, and valid until delEmitter. Particles it spawned live on.
+	ParticleEmitter* addEmitter(const ParticleEmitter& params);
+	void delEmitter(ParticleEmitter* em);
+
+	// spawns n particles at once, whether em is active or not.
+	void burst(const ParticleEmitter& em, size_t n);
+
+	void setGravity(glm::vec2 g){
+		gravity = g;
+	}
+
+	// alpha blended by default, like everything else.
+	void setBlendMode(const BlendMode& bm){
+		renderable.blend_mode = bm;
+	}
+
+	// moves, kills and spawns particles, then writes the instance data.
+	void update(uint32_t delta);
+
+	void draw(Renderer& r);
+	void draw(CommandList& cl);
+
+	size_t size() const {
+		return count;
+	}
+
+	size_t capacity() const {
+		return max_particles;
+	}
+
+	bool isInstanced() const {
+		return instanced;
+	}
+private:
+	struct Particles {
+		std::vector<float> x, y, vx, vy, life, inv_life, size;
+		std::vector<uint32_t> color;
+	};
+
+	// only used without instancing, the 16-bit quad indices reach this many particles each.
+	struct Page {
+		Page(const Renderable& r);
+
+		VertexState vao;
+		DynamicVertexBuffer vertices;
+		Renderable renderable;
+	};
+
+	static const size_t page_size = QuadIndexBuffer::max_quads;
+
+	void writeInstances();
+	void writeVertices();
+
+	void spawn(const ParticleEmitter& em, size_t n);
+	void kill(size_t i);
+	float random(float lo, float hi);
+	void forRange(size_t n, const std::function<void(size_t, size_t)>& fn);
+
+	Particles p;
+	size_t count, written, max_particles; // written: how many the vertex data holds.
+	glm::vec2 gravity;
+	uint32_t rng;
+
+	std::vector<std::unique_ptr<ParticleEmitter>> emitters;
+	std::vector<float> spawn_acc;
+
+	JobSystem* jobs;
+	bool instanced;
+	VertexState vao;
+	std::unique_ptr<StaticVertexBuffer> corners;
+	std::unique_ptr<DynamicVertexBuffer> instances;
+	std::shared_ptr<QuadIndexBuffer> indices;
+	std::vector<std::unique_ptr<Page>> pages;
+	Renderable renderable;
+};
+
+#endif
@@ -5,6 +5,14 @@
 #include <vector>
 #include "shader_uniforms.h"
 #include "render_state.h"
+#include "camera.h"
+#include "uniform_buffer.h"
+#include "renderable.h"
+#include "command_list.h"
+#include "gpu_timer.h"
+#include "framebuffer.h"
+#include <functional>
+#include <unordered_map>
 
 struct Renderer {
 	Renderer(Engine& e, const char* name);
@@ -12,18 +20,156 @@ struct Renderer {
 	void handleResize(float w, float h);
 
 	void drawFrame();
+	// blocks until the render thread is done with the last frame, if there is one.
+	void waitForFrame();
 	
+	enum Layer {
+		LAYER_SCENE,
+		// drawn after the scene has been scaled to the window, so it stays at native resolution.
+		LAYER_UI
+	};
+
+	// where addRenderable & co. put things from now on, until the end of the frame.
+	void setLayer(Layer l){
+		current = (l == LAYER_UI) ? &ui_commands : &commands;
+	}
+
 	void addRenderable(Renderable& r);
+	void submit(const CommandList& cl);
+
+	// calls fn(i, list) for i in [0, n) as jobs, each recording into its own list, then
+	// submits the lists in order of i. fn mustn't touch GL, or anything another job uses.
+	// SpriteBatch and ParticleSystem can draw into a list, Text and Canvas can't yet.
+	void recordParallel(size_t n, const std::function<void(size_t, CommandList&)>& fn);
+
+	CommandList& getCommandList(){
+		return *current;
+	}
+
+	// groups what's added from now on under label in the GPU timings.
+	void setLabel(const char* label){
+		current->setLabel(label);
+	}
 	
 	SDL_Window* getWindow() const {
 		return window;
 	}
+
+	Camera& getCamera(){
+		return camera;
+	}
+
+	TextureLoader& getTextureLoader(){
+		return *tex_loader;
+	}
+
+	// stats from the last completed frame.
+	const RenderStats& getStats() const {
+		return frame_stats;
+	}
+
+	// GPU time per label from a few frames ago, empty if GPU timers aren't available.
+	const std::vector<GpuTimer::Result>& getGpuTimes() const {
+		return gpu_times;
+	}
+	float getGpuFrameMs() const {
+		return gpu_frame_ms;
+	}
+
+	// reads back every frame drawn from now on before presenting it. Slow, for tests.
+	void setCapture(bool enabled){
+		capture = enabled;
+	}
+
+	// the last captured frame as RGBA8, top row first. false if there isn't one yet.
+	bool readPixels(std::vector<uint8_t>& rgba, int& w, int& h);
+
+	bool isHeadless() const;
+
+	// the fraction of the window size the scene is currently drawn at, always 1 without
+	// framebuffer support.
+	float getRenderScale() const {
+		return scene_scale;
+	}
 		
 	~Renderer();
 private:
-	std::vector<Renderable*> renderables;
+	/* A frame recorded for the render thread: copies of the renderables, with their
+	   uniforms snapshotted so the main thread can carry on changing the originals. */
+	struct FramePacket {
+		std::vector<Renderable> renderables;
+		std::vector<const char*> labels;
+		size_t num_scene;
+		std::vector<ShaderUniforms> uniforms;
+		std::unordered_map<const ShaderUniforms*, size_t> uniform_index;
+		ShaderUniforms main_uniforms;
+		int width, height;
+		int scene_w, scene_h;
+		bool offscreen, capture;
+		GLsync fence;
+		std::vector<GLuint> dead_vaos; // from VertexStates deleted since the last frame.
+	};
+
+	void draw(RenderState& rs, Renderable& r, const ShaderUniforms& main_u, bool upload);
+	void drawCommands(const CommandList& cl, const char*& group);
+	void capturePixels(int w, int h);
+	void saveScreenshot();
+	void markGroup(const char*& group, const char* label);
+	void readGpuTimes();
+	void updateRenderScale();
+	void getSceneSize(int& w, int& h) const;
+	bool prepareScene(RenderState& rs, int scene_w, int scene_h);
+	bool beginScene(bool offscreen, int w, int h, int scene_w, int scene_h);
+	void endScene(bool offscreen, int w, int h, int scene_w, int scene_h);
+	void updateCamera();
+	void recordFrame(FramePacket& p);
+	void executeFrame(FramePacket& p);
+	void startRenderThread();
+	void stopRenderThread();
+	static int renderThreadMain(void* self);
+
+	CommandList commands;
+	CommandList ui_commands;
+	CommandList* current;
+	std::vector<std::unique_ptr<CommandList>> job_lists;
+	JobSystem* jobs;
 	
 	RenderState render_state;
+	RenderStats frame_stats;
+
+	// render thread mode: the main thread keeps its own context for creating objects and
+	// uploading, while the render thread draws through a second one sharing its objects.
+	RenderState upload_state;
+	RenderStats render_stats;
+	FramePacket packets[2];
+	int next_packet;
+	SDL_GLContext render_ctx;
+	SDL_Thread* render_thread;
+	SDL_mutex* frame_lock;
+	SDL_cond* frame_cond;
+	FramePacket* pending_frame;
+	bool render_quit;
+	GLuint upload_vao;
+
+	std::unique_ptr<GpuTimer> gpu_timer;
+	std::vector<GpuTimer::Result> gpu_times;
+	float gpu_frame_ms;
+
+	// the scene is drawn here and scaled up to the window when vid_render_scale != 1.
+	std::unique_ptr<Framebuffer> scene_target;
+
+	// vid_dynamic_res: the scale follows the smoothed frame time, see updateRenderScale.
+	float scene_scale;
+	float cpu_frame_ms;              // not counting time blocked on the swap / render thread.
+	uint64_t prev_frame_time;
+	uint64_t idle_time;
+	int scale_cooldown;
+
+	bool capture, capture_once, capture_ready;
+	std::vector<uint8_t> capture_pixels;
+	int capture_w, capture_h;
+	alt::StrMut screenshot_name;
+	ResourceSystem* res;
 		
 	CVarBool* gl_debug;
 	CVarBool* gl_fwd_compat;
@@ -33,14 +179,27 @@ private:
 	CVarInt* window_height;
 	CVarInt* vsync;
 	CVarInt* fov;
+	CVarFloat* render_scale;
+	CVarBool* dynamic_res;
+	CVarFloat* target_ms;
+	CVarFloat* min_scale;
+	CVarFloat* max_scale;
 	CVarInt* display_index;
 	CVarBool* fullscreen;
 	CVarBool* resizable;
+	CVarBool* threaded;
+	CVarBool* gpu_timers;
+	CVarBool* headless;
 	
 	const char* window_title;
 	SDL_Window* window;
 	
 	ShaderUniforms main_uniforms;
+	GlobalUniforms globals;
+	std::unique_ptr<UniformBuffer> globals_ubo;
+	Camera camera;
+	uint32_t camera_version;
+	std::unique_ptr<TextureLoader> tex_loader;
 public:
 	const int &window_w, &window_h;
 };
@@ -3,22 +3,59 @@
 #include "common.h"
 #include "gl_context.h"
 #include <vector>
-
-struct BufferInvalidateListener {
-	virtual void onBufferRangeInvalidated(size_t off, size_t len) = 0;
-};
+#include <map>
 
 struct BufferRange {
 	size_t off, len;
-	BufferInvalidateListener* callback;
+};
+
+/* Typed view into a dynamic buffer's data, for writing a run of elements in place.
+   Only valid until the next call that can grow the buffer. */
+template<class T>
+struct BufferSpan {
+	T* begin() const { return ptr; }
+	T* end()   const { return ptr + count; }
+	T& operator[](size_t i) const { return ptr[i]; }
+	size_t size() const { return count; }
+
+	T* ptr;
+	size_t count;
+};
+
+/* Best-fit sub-allocator over a growable range of bytes. Freed blocks are merged
+   with any free neighbours and handed out again in place, so live blocks never move. */
+struct BufferAllocator {
+	BufferAllocator();
+
+	size_t alloc(size_t len);
+	size_t append(size_t len);
+	bool   extend(const BufferRange& r, size_t new_len);
+	void   free(const BufferRange& r);
+	void   clear();
+
+	size_t size() const {
+		return end;
+	}
+private:
+	void addFree(size_t off, size_t len);
+	void delFree(std::map<size_t, size_t>::iterator it);
+
+	std::map<size_t, size_t> free_by_off;
+	std::multimap<size_t, size_t> free_by_len;
+	size_t end;
 };
 
 struct StreamingBuffer : public GLObject {
 
 	StreamingBuffer();
 	StreamingBuffer(GLenum type, std::vector<uint8_t>& buff, bool append_only);
+	size_t alloc(size_t len);
+	size_t append(size_t len);
+	bool extend(const BufferRange& range, size_t new_len);
+	void free(const BufferRange& range);
+	void clear();
 	void mark();
-	void invalidate(BufferRange&& range);
+	void mark(size_t off, size_t len);
 	void invalidateAll();
 	void update(RenderState& rs);
 	void onGLContextRecreate();
@@ -29,10 +66,11 @@ struct StreamingBuffer : public GLObject {
 
 private:
 	std::vector<uint8_t>* data;
-	std::vector<BufferRange> unused_ranges;
+	BufferAllocator allocator;
 	GLuint id;
 	GLenum type;
-	size_t prev_size, prev_capacity, unused_bytes;
+	std::vector<BufferRange> dirty_ranges;
+	size_t prev_size, prev_capacity;
 	bool dirty, no_async;
 };
 
@@ -0,0 +1,56 @@
+#ifndef COMMAND_LIST_H_
+#define COMMAND_LIST_H_
+#include "common.h"
+#include <vector>
+
+/* Draws recorded by one thread, to be submitted to the Renderer afterwards. Recording
+   doesn't touch GL or the Renderer, so each job can fill its own list while objects
+   write vertex data into their own buffers, see Renderer::recordParallel. */
+struct CommandList {
+	CommandList() : renderables(), labels(), label(nullptr){}
+	CommandList(const CommandList&) = delete;
+	CommandList& operator=(const CommandList&) = delete;
+
+	void addRenderable(Renderable& r){
+		renderables.push_back(&r);
+		labels.push_back(label);
+	}
+
+	// renderables added after this are grouped under label for GPU timing, see GpuTimer.
+	void setLabel(const char* l){
+		label = l;
+	}
+
+	const char* getLabel(size_t i) const {
+		return labels[i];
+	}
+
+	void append(const CommandList& other){
+		renderables.insert(renderables.end(), other.renderables.begin(), other.renderables.end());
+		labels.insert(labels.end(), other.labels.begin(), other.labels.end());
+	}
+
+	void clear(){
+		renderables.clear();
+		labels.clear();
+		label = nullptr;
+	}
+
+	size_t size() const {
+		return renderables.size();
+	}
+
+	Renderable* const* begin() const {
+		return renderables.data();
+	}
+
+	Renderable* const* end() const {
+		return renderables.data() + renderables.size();
+	}
+private:
+	std::vector<Renderable*> renderables;
+	std::vector<const char*> labels;
+	const char* label;
+};
+
+#endif
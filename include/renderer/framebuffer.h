@@ -0,0 +1,53 @@
+#ifndef FRAMEBUFFER_H_
+#define FRAMEBUFFER_H_
+#include "common.h"
+#include "gl_context.h"
+#include "texture.h"
+#include <tuple>
+
+/* Offscreen render target with a colour texture and an optional depth renderbuffer.
+   The attachments are shared between contexts but the framebuffer object itself isn't,
+   so resize() can happen on any thread while the object is made by whichever thread
+   binds it, which should deleteFramebuffer() before its context goes away. */
+struct Framebuffer : public GLObject {
+	Framebuffer(GLenum color_fmt = GL_RGBA8, bool depth = true);
+	Framebuffer(const Framebuffer&) = delete;
+	Framebuffer& operator=(const Framebuffer&) = delete;
+
+	static bool isSupported();
+
+	// recreates the attachments if the size changed, returning true if it did.
+	// like creating any texture, that leaves the new one bound to the active unit.
+	bool resize(int w, int h);
+
+	// false if it couldn't be made complete, in which case the window stays bound.
+	bool bind();
+	static void bindDefault();
+
+	// copies the colour attachment onto the window, scaled to w x h.
+	void blitToDefault(int w, int h, GLenum filter = GL_LINEAR) const;
+	// same, but only the src_w x src_h region in the bottom left.
+	void blitToDefault(int src_w, int src_h, int w, int h, GLenum filter) const;
+
+	void deleteFramebuffer();
+	void clear();
+
+	const Texture2D& getTexture() const {
+		return color;
+	}
+
+	std::tuple<int, int> getSize() const {
+		return std::make_tuple(w, h);
+	}
+
+	void onGLContextRecreate();
+	~Framebuffer();
+private:
+	GLuint id, depth_id;
+	Texture2D color;
+	int w, h;
+	GLenum color_fmt, status;
+	bool has_depth;
+};
+
+#endif
@@ -11,6 +11,8 @@
 struct GLContext {
 	GLContext();
 	bool createContext(Engine& e, SDL_Window* w);
+	// a second context sharing objects with the main one, for use on another thread.
+	SDL_GLContext createSharedContext(SDL_Window* w);
 	void deleteContext(void);
 	bool hasExtension(const char* ext);
 	bool initialized();
@@ -19,9 +21,16 @@ struct GLContext {
 	void validateObject(const GLObject& obj);
 	void unregisterObject(GLObject& obj);
 
+	// blocks until the render thread is done with the frame it's drawing, if there is one.
+	// anything a FramePacket can point at calls this first thing in its destructor.
+	void waitForFrame();
+
 	uint32_t version;
 	
 	CVarEnum* streaming_mode;
+	CVarBool* program_cache;
+	ResourceSystem* res;
+	Renderer* renderer; // only set while it has a render thread.
 
 	GLenum         (APIENTRY* GetError)(void);
 	const GLubyte* (APIENTRY* GetString)(GLenum);
@@ -9,13 +9,38 @@ GLFUNC(void, Viewport, (GLint, GLint, GLsizei, GLsizei))
 GLFUNC(void, Enable, (GLenum))
 GLFUNC(void, Disable, (GLenum))
 GLFUNC(void, PixelStorei, (GLenum, GLint))
+GLFUNC(void, ReadPixels, (GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, GLvoid*))
+GLFUNC(void, Flush, (void))
+GLFUNC(void, Finish, (void))
+
+GLFUNC(GLsync, FenceSync, (GLenum, GLbitfield), OPTIONAL | ARBCORE | 32, "sync")
+GLFUNC(void, WaitSync, (GLsync, GLbitfield, GLuint64), OPTIONAL | ARBCORE | 32, "sync")
+GLFUNC(void, DeleteSync, (GLsync), OPTIONAL | ARBCORE | 32, "sync")
+
+GLFUNC(void, GenQueries, (GLsizei, GLuint*), OPTIONAL | 15)
+GLFUNC(void, DeleteQueries, (GLsizei, const GLuint*), OPTIONAL | 15)
+GLFUNC(void, BeginQuery, (GLenum, GLuint), OPTIONAL | 15)
+GLFUNC(void, EndQuery, (GLenum), OPTIONAL | 15)
+GLFUNC(void, GetQueryiv, (GLenum, GLenum, GLint*), OPTIONAL | 15)
+GLFUNC(void, GetQueryObjectiv, (GLuint, GLenum, GLint*), OPTIONAL | 15)
+GLFUNC(void, QueryCounter, (GLuint, GLenum), OPTIONAL | ARBCORE | 33, "timer_query")
+GLFUNC(void, GetQueryObjectui64v, (GLuint, GLenum, GLuint64*), OPTIONAL | ARBCORE | 33, "timer_query")
 
 GLFUNC(void, DrawArrays, (GLenum, GLint, GLsizei))
 GLFUNC(void, DrawElements, (GLenum, GLsizei, GLenum, const GLvoid*))
+GLFUNC(void, DrawElementsInstanced, (GLenum, GLsizei, GLenum, const GLvoid*, GLsizei), OPTIONAL | ARB | EXT | 31, "draw_instanced")
 
 GLFUNC(void, GenFramebuffers, (GLsizei, GLuint*), OPTIONAL |ARBCORE | EXT | 30, "framebuffer_object")
 GLFUNC(void, BindFramebuffer, (GLenum, GLuint), OPTIONAL | ARBCORE | EXT | 30, "framebuffer_object")
-GLFUNC(void, FramebufferTexture2D, (GLenum, GLenum, GLuint, GLint), OPTIONAL | ARBCORE | EXT | 30, "framebuffer_object")
+GLFUNC(void, DeleteFramebuffers, (GLsizei, const GLuint*), OPTIONAL | ARBCORE | EXT | 30, "framebuffer_object")
+GLFUNC(GLenum, CheckFramebufferStatus, (GLenum), OPTIONAL | ARBCORE | EXT | 30, "framebuffer_object")
+GLFUNC(void, FramebufferTexture2D, (GLenum, GLenum, GLenum, GLuint, GLint), OPTIONAL | ARBCORE | EXT | 30, "framebuffer_object")
+GLFUNC(void, GenRenderbuffers, (GLsizei, GLuint*), OPTIONAL | ARBCORE | EXT | 30, "framebuffer_object")
+GLFUNC(void, DeleteRenderbuffers, (GLsizei, const GLuint*), OPTIONAL | ARBCORE | EXT | 30, "framebuffer_object")
+GLFUNC(void, BindRenderbuffer, (GLenum, GLuint), OPTIONAL | ARBCORE | EXT | 30, "framebuffer_object")
+GLFUNC(void, RenderbufferStorage, (GLenum, GLenum, GLsizei, GLsizei), OPTIONAL | ARBCORE | EXT | 30, "framebuffer_object")
+GLFUNC(void, FramebufferRenderbuffer, (GLenum, GLenum, GLenum, GLuint), OPTIONAL | ARBCORE | EXT | 30, "framebuffer_object")
+GLFUNC(void, BlitFramebuffer, (GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLbitfield, GLenum), OPTIONAL | ARBCORE | 30, "framebuffer_object")
 
 GLFUNC(void, GenBuffers, (GLsizei, GLuint*))
 GLFUNC(void, BindBuffer, (GLenum, GLuint))
@@ -34,6 +59,7 @@ GLFUNC(void, BindVertexBuffer, (GLuint, GLuint, GLintptr, GLsizei), OPTIONAL | A
 GLFUNC(void, VertexAttribFormat, (GLuint, GLint, GLenum, GLboolean, GLuint), OPTIONAL | ARBCORE | 43, "vertex_attrib_binding")
 GLFUNC(void, VertexAttribIFormat, (GLuint, GLint, GLenum, GLuint), OPTIONAL | ARBCORE | 43, "vertex_attrib_binding")
 GLFUNC(void, VertexAttribBinding, (GLuint, GLuint), OPTIONAL | ARBCORE | 43, "vertex_attrib_binding")
+GLFUNC(void, VertexBindingDivisor, (GLuint, GLuint), OPTIONAL | ARBCORE | 43, "vertex_attrib_binding")
 GLFUNC(void, VertexAttribDivisor, (GLuint, GLuint), OPTIONAL | ARB | 33, "instanced_arrays")
 GLFUNC(void, VertexAttribPointer, (GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid*))
 GLFUNC(void, VertexAttribIPointer, (GLuint, GLint, GLenum, GLsizei, const GLvoid*), OPTIONAL | 30)
@@ -46,10 +72,13 @@ GLFUNC(void, ActiveTexture, (GLenum))
 GLFUNC(void, TexStorage2D, (GLenum, GLsizei, GLenum, GLsizei, GLsizei), OPTIONAL | ARBCORE | EXT | 42, "texture_storage")
 GLFUNC(void, TexImage2D, (GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const GLvoid*))
 GLFUNC(void, TexSubImage2D, (GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const GLvoid*))
+GLFUNC(void, TexStorage3D, (GLenum, GLsizei, GLenum, GLsizei, GLsizei, GLsizei), OPTIONAL | ARBCORE | EXT | 42, "texture_storage")
+GLFUNC(void, TexImage3D, (GLenum, GLint, GLint, GLsizei, GLsizei, GLsizei, GLint, GLenum, GLenum, const GLvoid*), OPTIONAL | 12)
+GLFUNC(void, TexSubImage3D, (GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei, GLenum, GLenum, const GLvoid*), OPTIONAL | 12)
 GLFUNC(void, TexParameteri, (GLenum, GLenum, GLint))
 GLFUNC(void, TexParameteriv, (GLenum, GLenum, const GLint*))
 GLFUNC(void, DeleteTextures, (GLsizei, const GLuint*))
-//GLFUNC(void, GenerateMipmap, (GLenum), OPTIONAL)
+GLFUNC(void, GenerateMipmap, (GLenum), OPTIONAL | ARBCORE | EXT | 30, "framebuffer_object")
 
 GLFUNC(void, GenSamplers, (GLsizei, GLuint*), OPTIONAL | ARBCORE | 33, "sampler_objects")
 GLFUNC(void, DeleteSamplers, (GLsizei, const GLuint*), OPTIONAL | ARBCORE | 33, "sampler_objects")
@@ -69,6 +98,9 @@ GLFUNC(GLuint, CreateProgram, (void))
 GLFUNC(void, LinkProgram, (GLuint))
 GLFUNC(void, GetProgramiv, (GLuint, GLenum, GLint*))
 GLFUNC(void, GetProgramInfoLog, (GLuint, GLsizei, GLsizei*, GLchar*))
+GLFUNC(void, GetProgramBinary, (GLuint, GLsizei, GLsizei*, GLenum*, GLvoid*), OPTIONAL | ARBCORE | 41, "get_program_binary")
+GLFUNC(void, ProgramBinary, (GLuint, GLenum, const GLvoid*, GLsizei), OPTIONAL | ARBCORE | 41, "get_program_binary")
+GLFUNC(void, ProgramParameteri, (GLuint, GLenum, GLint), OPTIONAL | ARBCORE | 41, "get_program_binary")
 GLFUNC(void, UseProgram, (GLuint))
 GLFUNC(void, DeleteProgram, (GLuint))
 
@@ -111,6 +143,11 @@ GLFUNC(void, UniformMatrix4x2fv, (GLint, GLsizei, GLboolean, const GLfloat*), OP
 GLFUNC(void, UniformMatrix3x4fv, (GLint, GLsizei, GLboolean, const GLfloat*), OPTIONAL | 21)
 GLFUNC(void, UniformMatrix4x3fv, (GLint, GLsizei, GLboolean, const GLfloat*), OPTIONAL | 21)
 
+GLFUNC(GLuint, GetUniformBlockIndex, (GLuint, const GLchar*), OPTIONAL | ARBCORE | 31, "uniform_buffer_object")
+GLFUNC(void, UniformBlockBinding, (GLuint, GLuint, GLuint), OPTIONAL | ARBCORE | 31, "uniform_buffer_object")
+GLFUNC(void, GetActiveUniformBlockiv, (GLuint, GLuint, GLenum, GLint*), OPTIONAL | ARBCORE | 31, "uniform_buffer_object")
+GLFUNC(void, BindBufferBase, (GLenum, GLuint, GLuint), OPTIONAL | ARBCORE | 31, "uniform_buffer_object")
+
 GLFUNC(void, BlendFuncSeparate, (GLenum, GLenum, GLenum, GLenum))
 GLFUNC(void, BlendEquationSeparate, (GLenum, GLenum))
 
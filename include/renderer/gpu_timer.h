@@ -0,0 +1,61 @@
+#ifndef GPU_TIMER_H_
+#define GPU_TIMER_H_
+#include "common.h"
+#include "gl_context.h"
+#include <vector>
+
+/* GPU time per labelled group of draws. A GL_TIMESTAMP query is issued wherever the
+   label changes, with a GL_TIME_ELAPSED query around the whole frame. Frames are only
+   read back once their slot comes round again, and dropped if the results still
+   aren't ready, so the CPU never waits on them. */
+struct GpuTimer : public GLObject {
+	GpuTimer();
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	// false without timer queries, or on a software renderer where they mean little.
+	static bool isSupported();
+
+	void beginFrame();
+	void mark(const char* label);
+	void endFrame();
+
+	// deletes the queries, which must happen on the thread whose context made them.
+	void clear();
+
+	struct Result {
+		const char* label; // nullptr for draws without one.
+		float ms;
+	};
+
+	// averaged over the last few frames read back.
+	const std::vector<Result>& getResults() const {
+		return results;
+	}
+	float getFrameMs() const {
+		return frame_ms;
+	}
+
+	void onGLContextRecreate();
+	~GpuTimer();
+
+	static const int num_frames = 4;
+private:
+	struct Frame {
+		std::vector<GLuint> stamps;
+		std::vector<const char*> labels;
+		GLuint elapsed;
+		size_t used;
+		bool pending;
+	};
+
+	void collect(Frame& f);
+	void addResult(const char* label, float ms);
+
+	Frame frames[num_frames];
+	int current;
+	std::vector<Result> results;
+	float frame_ms;
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include "buffer_common.h"
 #include "resource_system.h"
 #include "render_state.h"
+#include <atomic>
 
 struct IndexBuffer : public GLObject {
 	virtual void   bind(RenderState&)  = 0;
@@ -30,6 +31,28 @@ private:
 	GLuint id;
 };
 
+/* Shared index buffer holding the { 0, 1, 2, 2, 1, 3 } pattern for consecutive
+   quads of 4 vertices each. Grows on demand, up to what 16-bit indices can address. */
+struct QuadIndexBuffer : public IndexBuffer {
+	static std::shared_ptr<QuadIndexBuffer> get();
+
+	QuadIndexBuffer();
+	void reserve(size_t quads);
+	void bind(RenderState&);
+	GLenum getType() const;
+	GLuint getID() const;
+	void update(RenderState&);
+	void onGLContextRecreate();
+	~QuadIndexBuffer();
+
+	static const size_t max_quads = 16384;
+private:
+	void upload();
+	size_t quads;
+	std::atomic<size_t> needed; // reserve() can be called from recording jobs.
+	GLuint id;
+};
+
 template<class T> struct index_type {};
 template<> struct index_type<uint8_t>{ static const GLenum value = GL_UNSIGNED_BYTE; };
 template<> struct index_type<uint16_t>{ static const GLenum value = GL_UNSIGNED_SHORT; };
@@ -46,26 +69,44 @@ struct DynamicIndexBuffer : public IndexBuffer {
 	void replace(size_t index, T val){
 		if((index + 1) * sizeof(T) > indices.size()) return;
 
-		auto* p = reinterpret_cast<const uint8_t*>(&val);
-		for(size_t i = 0; i < sizeof(T); ++i){
-			indices[index * sizeof(T) + i] = p[i];
-		}
-		stream_buf.invalidateAll();
+		memcpy(indices.data() + index * sizeof(T), &val, sizeof(T));
+		stream_buf.mark(index * sizeof(T), sizeof(T));
 	}
 	
 	void push(T val){
-		auto* p = reinterpret_cast<const uint8_t*>(&val);
-		for(size_t i = 0; i < sizeof(T); ++i){
-			indices.push_back(p[i]);
-		}
+		const size_t off = stream_buf.append(sizeof(T));
+		memcpy(indices.data() + off, &val, sizeof(T));
 		stream_buf.mark();
 	}
 
-	void clear(){
-		indices.clear();
+	void push_range(const T* begin, const T* end){
+		if(begin == end) return;
+
+		const size_t len = (end - begin) * sizeof(T);
+		const size_t off = stream_buf.append(len);
+		memcpy(indices.data() + off, begin, len);
 		stream_buf.mark();
 	}
 
+	BufferSpan<T> reserve_append(size_t n){
+		const size_t off = stream_buf.append(n * sizeof(T));
+		stream_buf.mark();
+
+		return BufferSpan<T>{ reinterpret_cast<T*>(indices.data() + off), n };
+	}
+
+	size_t alloc(size_t count){
+		return stream_buf.alloc(count * sizeof(T)) / sizeof(T);
+	}
+
+	void free(size_t index, size_t count){
+		stream_buf.free(BufferRange{ index * sizeof(T), count * sizeof(T) });
+	}
+
+	void clear(){
+		stream_buf.clear();
+	}
+
 	GLenum getType() const {
 		return index_type<T>::value;
 	}
@@ -94,6 +135,10 @@ struct DynamicIndexBuffer : public IndexBuffer {
 		gl.validateObject(stream_buf);
 	}
 
+	~DynamicIndexBuffer(){
+		gl.waitForFrame();
+	}
+
 private:
 	std::vector<uint8_t> indices;
 	StreamingBuffer stream_buf;
@@ -0,0 +1,11 @@
+#ifndef PNG_WRITER_H_
+#define PNG_WRITER_H_
+#include "common.h"
+#include <vector>
+
+/* Encodes RGBA8 pixels, top row first, as a PNG. The image data goes in stored
+   (uncompressed) deflate blocks so there's no zlib dependency, which makes the files
+   about as big as the pixels themselves. Good enough for screenshots and test output. */
+void png_encode(const uint8_t* rgba, int w, int h, std::vector<uint8_t>& out);
+
+#endif
@@ -7,6 +7,11 @@
 #include <array>
 #include <bitset>
 
+struct RenderStats {
+	size_t bytes_uploaded;
+	size_t buffer_uploads;
+};
+
 struct RenderState {
 	GLuint program;
 	GLuint active_tex;
@@ -18,9 +23,12 @@ struct RenderState {
 	GLuint ibo;
 
 	std::bitset<16> enabled_attrib_arrays; // used when VAOs aren't supported.
-	ShaderAttribs active_attribs;          // used when VAOs aren't supported.
+	uint32_t attrib_vstate;                // used when VAOs aren't supported, the
+	GLuint attrib_program;                 // (VertexState, program) the arrays are set for.
 
 	BlendMode blend_mode{{{ GL_ONE, GL_ZERO, GL_ONE, GL_ZERO }}};
+
+	RenderStats stats;                     // reset by the Renderer every frame.
 };
 
 #endif
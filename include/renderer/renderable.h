@@ -9,6 +9,7 @@
 struct RCount { GLsizei value; };
 struct RType  { GLenum  value; };
 struct ROff   { GLint   value; };
+struct RInstances { GLsizei value; };
 
 struct Renderable {
 
@@ -19,6 +20,7 @@ struct Renderable {
 	void set(RCount c){ count = c.value; }
 	void set(RType t){ prim_type = t.value; }
 	void set(ROff o){ offset = o.value; }
+	void set(RInstances i){ instances = i.value; }
 
 	template<class T, class... Args>
 	void set(T&& t, Args&&... args){
@@ -35,7 +37,8 @@ struct Renderable {
 	, blend_mode()
 	, prim_type(GL_TRIANGLES)
 	, count(0)
-	, offset(0) {
+	, offset(0)
+	, instances(0) {
 	
 	}
 	
@@ -74,6 +77,7 @@ struct Renderable {
 	GLenum    prim_type;
 	GLsizei   count;
 	GLint     offset;
+	GLsizei   instances; // 0 for a regular non-instanced draw.
 	
 };
 
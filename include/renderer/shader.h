@@ -8,13 +8,23 @@
 
 struct VertexState;
 
+/* Holds the source, and only compiles it the first time the id is needed,
+   so programs loaded from the binary cache never compile their shaders. */
 struct ShaderBase : public GLObject {
 	ShaderBase(GLenum type, MemBlock mem);
 	GLuint getID() const;
+	uint32_t getHash() const {
+		return hash;
+	}
+	virtual void onGLContextRecreate();
 	virtual ~ShaderBase();
 protected:
+	void compile() const;
+
 	GLenum type;
-	GLuint id;
+	mutable GLuint id;
+	std::vector<GLchar> src;
+	uint32_t hash;
 };
 
 struct VertShader : ShaderBase {
@@ -31,16 +41,24 @@ struct ShaderProgram : public GLObject {
 	bool bind(RenderState& rs);
 	void setUniforms(const ShaderUniforms& uniforms);
 	void setAttribs(RenderState& rs, VertexState& vstate);
+	// true if the program reads the Renderer's globals from the GlobalUniforms block.
+	bool usesGlobals() const {
+		return uses_globals;
+	}
 	virtual void onGLContextRecreate();
 
 	~ShaderProgram();
 private:
+	bool loadBinary(uint32_t key);
+	void saveBinary(uint32_t key);
+
 	Proxy<VertShader> vs;
 	Proxy<FragShader> fs;
 	GLuint program_id;
 
 	ShaderUniforms uniforms;
 	ShaderAttribs  attribs;
+	bool uses_globals;
 };
 
 #endif
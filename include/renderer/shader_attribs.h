@@ -30,6 +30,7 @@ struct ShaderAttribs {
 	void clear();
 
 	bool containsAttrib(uint32_t hash, GLint at_index = -1) const;
+	bool isInstanced() const;
 	
 	const Attrib* begin() const;
 	const Attrib* end() const;
@@ -11,8 +11,13 @@ template<> struct get_glenum<float>{ static const GLenum value = GL_FLOAT; };
 template<> struct get_glenum<int>{ static const GLenum value = GL_INT; };
 template<> struct get_glenum<unsigned>{ static const GLenum value = GL_UNSIGNED_INT; };
 
+/* Uniform values to be set on a ShaderProgram. Each value carries a version that is
+   bumped whenever it is set, and the program keeps a per-object binding plan (see
+   bind), so binding only walks a flat array and uploads what actually changed. */
 struct ShaderUniforms {
 	ShaderUniforms();
+	ShaderUniforms(const ShaderUniforms& other);
+	ShaderUniforms& operator=(const ShaderUniforms& other);
 	
 	template<class T>
 	void setUniform(const str_const& str, std::initializer_list<T>&& t){
@@ -56,9 +61,14 @@ struct ShaderUniforms {
 	
 	void initUniform(const char* name, GLuint prog, GLint idx, GLuint size, GLenum full_type);
 	bool operator==(const ShaderUniforms& other) const;
+	// copies other's values *and* identity, so binding the copy later does the same as
+	// binding other would have at the time of the copy. Used to hand frames to another thread.
+	void snapshot(const ShaderUniforms& other);
+	// current is the program's own set of active uniforms, which also holds the plans.
 	bool bind(GLuint program_id, ShaderUniforms& current) const;
 	void clear();
 
+	static const size_t max_plans = 64;
 private:
 
 	void _setUniform(uint32_t hash, uint32_t rows, uint32_t cols, uint32_t n, GLenum type, const void* ptr);
@@ -68,15 +78,35 @@ private:
 		size_t storage_index;
 		GLenum type;
 		GLint idx;
+		uint32_t version;       // for active uniforms: the version last uploaded...
+		uint32_t bound_serial;  // ... and the serial of the object it came from.
 
 		bool operator==(uint32_t h) const { return name_hash == h; }
 	};
 
+	struct PlanEntry {
+		GLint loc;
+		uint32_t rows, cols, count;
+		GLenum type;
+		size_t storage_index;
+		size_t src_index, active_index;
+	};
+
+	struct Plan {
+		uint32_t serial, layout;
+		std::vector<PlanEntry> entries;
+	};
+
+	void buildPlan(Plan& plan, const ShaderUniforms& active) const;
+
 	typedef variant<GLint, GLuint, GLfloat>::type ustorage;
 	static_assert(sizeof(ustorage) == 4, "ustorage should be 4 bytes");
 
 	std::vector<ustorage> uniforms;
 	std::vector<uinfo> uniform_info;
+	std::vector<Plan> plans;
+	uint32_t serial;
+	uint32_t layout;
 };
 
 #endif
@@ -6,7 +6,7 @@
 
 struct Sprite {
 
-	Sprite() = default;
+	Sprite();
 	Sprite(SpriteBatch& batch, glm::ivec2 position  = { 0, 0 },
 	                           glm::ivec2 size      = { 0, 0 },
 	                           glm::ivec2 tex_frame = { 0, 0 });
@@ -17,15 +17,22 @@ struct Sprite {
 	void setPosition(glm::ivec2 pos);
 	void setSize(glm::ivec2 size);
 	void setFrame(glm::ivec2 frame);
+	// use a TextureAtlas region instead of the batch's tex_cells grid, nullptr to go back.
+	void setRegion(const AtlasRegion* region);
 
 	glm::ivec2 getPosition() const { return position; }
 	glm::ivec2 getSize()     const { return size; }
 	glm::ivec2 getFrame()    const { return tex_frame; }
+	const AtlasRegion* getRegion() const { return region; }
 
 	~Sprite();
 private:
+	friend struct SpriteBatch;
+
 	SpriteBatch* batch;
+	uint32_t slot;
 	glm::ivec2 position, size, tex_frame;
+	const AtlasRegion* region;
 };
 
 #endif
@@ -5,37 +5,82 @@
 #include "vertex_buffer.h"
 #include "vertex_state.h"
 #include "renderable.h"
-#include <map>
+#include <vector>
 
-struct SpriteBatch : public BufferInvalidateListener {
+struct SpriteBatch {
 
-	SpriteBatch() = default;
+	SpriteBatch();
+	// sprites with an AtlasRegion also write its page as a_layer, so a material using an
+	// array TextureAtlas, with sampler2DArray shaders, can draw every page in one batch.
 	SpriteBatch(Material& m, glm::ivec2 tex_cells = { 1, 1 });
 
-	void addSprite(const Sprite& s);
-	void delSprite(const Sprite& s);
+	// draws each sprite as one instance with inst_shader if the GL context can,
+	// otherwise falls back to the material's shader and 4 vertices per sprite.
+	SpriteBatch(Material& m, ShaderProgram& inst_shader, glm::ivec2 tex_cells = { 1, 1 });
+
+	void addSprite(Sprite& s);
+	void delSprite(Sprite& s);
+	void moveSprite(Sprite& from, Sprite& to);
 	void updateSprite(const Sprite& s);
 
 	const Material* getMaterial(){
 		return material;
 	}
 
-	void draw(Renderer& r);
+	bool isInstanced() const {
+		return instanced;
+	}
 
-	void onBufferRangeInvalidated(size_t off, size_t len) override;
+	// pages entirely outside the camera's view are skipped, nullptr draws everything.
+	void setCamera(Camera* c){
+		camera = c;
+	}
+
+	void draw(Renderer& r);
+	// only touches this batch's own buffers, so batches can be recorded as separate jobs.
+	void draw(CommandList& cl);
 
 private:
-	struct SpriteInfo {
-		size_t v_off, i_off;
-		bool dirty, hide;
+	SpriteBatch(Material& m, ShaderProgram* inst_shader, glm::ivec2 tex_cells);
+
+	// slot i lives in page i / page_size, and owns local vertices [j*4, j*4+4) of it
+	// drawn by the shared quad indices [j*6, j*6+6), or just instance j when instanced.
+	// lo, hi is the box last written for it, so its page's bounds can be rebuilt.
+	struct Slot {
+		Sprite* sprite;
+		glm::ivec2 lo, hi;
+		bool dirty;
+	};
+
+	// 16-bit indices can only reach so many vertices, so sprites past that go in new pages.
+	struct Page {
+		Page(const VertexLayout& layout, const Renderable& r);
+		void resetBounds();
+		// true if the slot's box is part of the page's edge, so losing it can shrink the page.
+		bool onEdge(const Slot& s) const;
+
+		VertexState vao;
+		DynamicVertexBuffer vertices;
+		Renderable renderable;
+		glm::ivec2 lo, hi;
+		bool bounds_dirty; // rebuilt from the slots before the next cull.
 	};
 
-	std::map<const Sprite*, SpriteInfo> sprites;
-	VertexState vao;
-	DynamicVertexBuffer vertices;
-	DynamicIndexBuffer<uint16_t> indices;
+	static const size_t page_size = QuadIndexBuffer::max_quads;
+
+	void markSlot(uint32_t slot);
+	Page& addPage();
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> dirty_slots;
+	std::vector<std::unique_ptr<Page>> pages;
+	bool instanced;
+	VertexLayout vertex_layout;
+	std::unique_ptr<StaticVertexBuffer> corners;
+	std::shared_ptr<QuadIndexBuffer> indices;
 	Material* material;
-	Renderable renderable;
+	Camera* camera;
+	Renderable renderable; // copied into every page.
 	glm::ivec2 tex_cells;
 };
 
@@ -4,6 +4,7 @@
 #include "util.h"
 #include "gl_context.h"
 #include <tuple>
+#include <vector>
 
 struct RenderState;
 
@@ -13,13 +14,37 @@ struct Texture {
 	virtual std::tuple<int, int> getSize() const = 0;
 	virtual bool bind(size_t tex_unit, RenderState& rs) const = 0;
 	virtual bool setSwizzle(const std::array<GLint, 4>& swizzle) = 0;
+	virtual bool isReady(void) const {
+		return true;
+	}
 	virtual ~Texture(){}
 };
 
+/* Box-filtered mip levels 1 and up of an RGBA8 image, stored back to back. */
+struct MipChain {
+	MipChain();
+	MipChain(const uint8_t* pixels, int w, int h);
+
+	static int numLevels(int w, int h);
+	// byte offset of a level in a full chain that starts with level 0.
+	static size_t levelOffset(int w, int h, int level);
+
+	const uint8_t* getLevel(int level) const;
+	int getNumLevels() const {
+		return levels;
+	}
+private:
+	std::vector<uint8_t> data;
+	int w, h, levels;
+};
+
 struct Texture2D : public Texture, public GLObject {
 	Texture2D();
 	Texture2D(MemBlock mem);
-	Texture2D(GLenum fmt, GLenum int_fmt, int w, int h, const void* data);
+	// decodes asynchronously through the renderer's TextureLoader if r_tex_async is set.
+	Texture2D(Engine& e, MemBlock mem);
+	// if levels > 1 and data is given, the rest of the mip chain is generated from it.
+	Texture2D(GLenum fmt, GLenum int_fmt, int w, int h, const void* data, int levels = 1);
 	Texture2D& operator=(const Texture2D&) = delete;
 	Texture2D& operator=(Texture2D&&);
 	
@@ -28,11 +53,49 @@ struct Texture2D : public Texture, public GLObject {
 	std::tuple<int, int> getSize() const;
 	bool bind(size_t tex_unit, RenderState& rs) const;
 	bool setSwizzle(const std::array<GLint, 4>& swizzle);
+	bool isReady(void) const;
+	int getLevels(void) const;
+	GLuint getID(void) const {
+		return id;
+	}
 	virtual void onGLContextRecreate();	
 	virtual ~Texture2D();
+private:
+	friend struct TextureLoader;
+	GLuint id;
+	int w, h, levels;
+	TextureLoader* loader;
+};
+
+/* Same-sized 2D layers behind a single binding, so e.g. every page of an atlas can
+   be drawn without switching textures. Needs GL 3.0 or EXT_texture_array. */
+struct Texture2DArray : public Texture, public GLObject {
+	Texture2DArray();
+	// data, if given, holds every layer back to back.
+	Texture2DArray(GLenum fmt, GLenum int_fmt, int w, int h, int layers, const void* data, int levels = 1);
+	Texture2DArray& operator=(const Texture2DArray&) = delete;
+	Texture2DArray& operator=(Texture2DArray&&);
+
+	static bool isSupported();
+
+	bool setLayer(int layer, const void* data);
+	void generateMipmaps();
+
+	int getLayers(void) const {
+		return layers;
+	}
+
+	GLenum getType(void) const;
+	bool isValid(void) const;
+	std::tuple<int, int> getSize() const;
+	bool bind(size_t tex_unit, RenderState& rs) const;
+	bool setSwizzle(const std::array<GLint, 4>& swizzle);
+	virtual void onGLContextRecreate();
+	virtual ~Texture2DArray();
 private:
 	GLuint id;
-	int w, h;
+	int w, h, layers, levels;
+	GLenum type, int_fmt;
 };
 
 #endif
@@ -0,0 +1,82 @@
+#ifndef TEXTURE_ATLAS_H_
+#define TEXTURE_ATLAS_H_
+#include "common.h"
+#include "gl_context.h"
+#include "texture.h"
+#include "glm/glm.hpp"
+#include <vector>
+
+/* Bottom-left skyline rectangle packer. */
+struct SkylinePacker {
+	SkylinePacker(int w, int h);
+	bool pack(int w, int h, glm::ivec2& pos);
+private:
+	struct Node {
+		int x, y, w;
+	};
+	int fit(size_t i, int w, int h) const;
+
+	std::vector<Node> skyline;
+	int width, height;
+};
+
+struct AtlasRegion {
+	uint32_t name_hash;
+	uint32_t page;
+	glm::ivec4 rect;  // x, y, w, h in pixels.
+	uint16_t tex[4];  // x0, y0, x1, y1 normalized to USHRT_MAX, as used by SpriteBatch.
+};
+
+/* Packs a set of images into as few Texture2D pages as possible, so sprites from
+   different source images can share a material, and be drawn by one SpriteBatch.
+   With use_array set (and driver support), the pages are instead the layers of a
+   single Texture2DArray, and AtlasRegion::page is the layer to sample with the
+   sampler2DArray shaders. Font glyph pages can be added to it too, see Font::addToAtlas. */
+struct TextureAtlas : public GLObject {
+	TextureAtlas(Engine& e, std::initializer_list<const char*> images, int page_size = 1024, int padding = 1, bool use_array = false);
+
+	const AtlasRegion* getRegion(const char* name) const;
+
+	// copies an RGBA8 image into a new page of its own, and returns its index.
+	// returns -1 if it doesn't fit in a page.
+	int addPage(const uint8_t* rgba, int w, int h);
+
+	int getPageSize() const {
+		return page_size;
+	}
+
+	size_t getNumPages() const {
+		return pages.size();
+	}
+
+	const Texture2D& getPage(size_t i) const {
+		assert(pages[i].tex);
+		return *pages[i].tex;
+	}
+
+	// nullptr unless the atlas was created with use_array.
+	const Texture2DArray* getArray() const {
+		return array.get();
+	}
+
+	void onGLContextRecreate();
+
+private:
+	struct Page {
+		Page(int size);
+		SkylinePacker packer;
+		std::vector<uint8_t> pixels;
+		std::unique_ptr<Texture2D> tex;
+	};
+
+	void createTextures();
+
+	std::vector<Page> pages;
+	std::vector<AtlasRegion> regions;
+	std::unique_ptr<Texture2DArray> array;
+	int page_size;
+	bool use_array;
+};
+
+#endif
+
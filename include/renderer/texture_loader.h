@@ -0,0 +1,95 @@
+#ifndef TEXTURE_LOADER_H_
+#define TEXTURE_LOADER_H_
+#include "common.h"
+#include "gl_context.h"
+#include "util.h"
+#include "resource_system.h"
+#include "texture.h"
+#include <vector>
+#include <atomic>
+
+/* Decoded RGBA8 pixels and optionally their mip chain, owned by stb_image or
+   pointing into a texture cache blob. */
+struct TextureImage {
+	TextureImage();
+	TextureImage(const TextureImage&) = delete;
+	TextureImage& operator=(const TextureImage&) = delete;
+	void reset();
+	const uint8_t* getLevel(int level) const;
+	~TextureImage();
+
+	const uint8_t* pixels;
+	int w, h, levels;
+private:
+	friend struct TextureLoader;
+	uint8_t* decoded;
+	MipChain mips;
+	ResourceHandle blob;
+};
+
+/* Decodes image files on the engine's worker threads, then streams the pixels into
+   their textures a few rows at a time, staying under a per-frame byte budget so a
+   burst of loads doesn't stall the frame. Rows are copied into a mapped ring of pixel
+   unpack buffers when the driver has them, so the copy to the texture happens on the
+   GPU's time instead of in TexSubImage2D. Textures show a placeholder until done.
+   Decoded pixels are kept in a cache in the user write dir (r_tex_cache), keyed by
+   a hash of the file, so later runs can skip decoding entirely. With r_tex_mipmaps
+   set, a box-filtered mip chain is built on the worker thread and cached as well. */
+struct TextureLoader : public GLObject {
+	TextureLoader(Engine& e);
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	bool isAsync() const;
+
+	void load(Texture2D& tex, MemBlock file);
+	bool decode(MemBlock file, TextureImage& out);
+	void cancel(Texture2D& tex);
+	// for Texture2D's move, so a pending load follows the texture's contents.
+	void swapTargets(Texture2D& a, Texture2D& b);
+	void update(RenderState& rs);
+
+	size_t numPending() const {
+		return requests.size();
+	}
+
+	const Texture2D& getPlaceholder();
+	void onGLContextRecreate();
+	~TextureLoader();
+
+	static const size_t num_pbos = 3;
+private:
+	enum { PENDING, DECODED, FAILED };
+
+	struct Request {
+		Request(Texture2D& tex, MemBlock file, int levels);
+
+		Texture2D* tex;
+		std::vector<uint8_t> file;
+		TextureImage image;
+		int w, h, levels;
+		int level, rows_done;
+		std::unique_ptr<Texture2D> target;
+		std::atomic<int> state;
+		std::atomic<bool> cancelled;
+	};
+
+	bool decode(MemBlock file, TextureImage& out, bool use_cache, bool mipmaps) const;
+	void upload(Request& req, int rows, RenderState& rs);
+	bool uploadPBO(const uint8_t* src, size_t bytes);
+	void dropTarget(Request& req);
+
+	Engine& engine;
+	std::vector<std::shared_ptr<Request>> requests;
+	std::unique_ptr<Texture2D> placeholder;
+	GLuint pbos[num_pbos];
+	size_t pbo_sizes[num_pbos];
+	size_t pbo_index;
+	bool use_pbos;
+	CVarBool* async;
+	CVarBool* use_cache;
+	CVarBool* mipmaps;
+	CVarInt* upload_budget;
+};
+
+#endif
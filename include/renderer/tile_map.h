@@ -0,0 +1,52 @@
+#ifndef TILE_MAP_H_
+#define TILE_MAP_H_
+#include "common.h"
+#include "index_buffer.h"
+#include "vertex_buffer.h"
+#include "vertex_state.h"
+#include "renderable.h"
+#include <vector>
+
+/* Static grid of tiles, baked into chunks of chunk_size * chunk_size tiles that are
+   only rebuilt when one of their tiles changes. Uses the same vertex format as
+   SpriteBatch, so materials / shaders can be shared between the two. */
+struct TileMap {
+
+	TileMap();
+	TileMap(Material& m, glm::ivec2 map_size, glm::ivec2 tile_size, glm::ivec2 tex_cells = { 1, 1 });
+
+	// tiles index the material's texture cells left to right, top to bottom.
+	void setTile(glm::ivec2 pos, uint16_t tile);
+	uint16_t getTile(glm::ivec2 pos) const;
+
+	// chunks entirely outside the camera's view are skipped, nullptr draws everything.
+	void setCamera(Camera* c){
+		camera = c;
+	}
+
+	void draw(Renderer& r);
+
+	static const uint16_t empty = 0xFFFF;
+	static const int chunk_size = 32;
+
+private:
+	struct Chunk {
+		Chunk(const Renderable& r);
+		VertexState vao;
+		StaticVertexBuffer vertices;
+		std::vector<uint8_t> data;
+		Renderable renderable;
+		bool dirty;
+	};
+
+	void buildChunk(int cx, int cy);
+
+	std::vector<uint16_t> tiles;
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	std::shared_ptr<QuadIndexBuffer> indices;
+	glm::ivec2 map_size, num_chunks, tile_size, tex_cells;
+	Camera* camera;
+};
+
+#endif
+
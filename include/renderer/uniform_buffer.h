@@ -0,0 +1,53 @@
+#ifndef UNIFORM_BUFFER_H_
+#define UNIFORM_BUFFER_H_
+#include "common.h"
+#include "gl_context.h"
+#include "glm/glm.hpp"
+#include <vector>
+
+/* Per-frame values shared by every shader, laid out to match this std140 block:
+
+	layout(std140) uniform Globals {
+		mat4 u_ortho;
+		mat4 u_perspective;
+		mat4 u_view;
+		vec4 u_viewport;  // w, h, 1/w, 1/h
+	};
+
+   Programs that declare it are bound to it when linked, and skip the per-uniform
+   path for the Renderer's globals. */
+struct GlobalUniforms {
+	glm::mat4 ortho;
+	glm::mat4 perspective;
+	glm::mat4 view;
+	glm::vec4 viewport;
+
+	static const GLuint binding = 0;
+	static constexpr const char* block_name = "Globals";
+};
+
+static_assert(sizeof(GlobalUniforms) == 208, "GlobalUniforms must match the std140 layout");
+
+/* A uniform buffer bound to a fixed binding point, and refilled from a CPU-side
+   copy, which is also used to restore it if the context is recreated. */
+struct UniformBuffer : public GLObject {
+	UniformBuffer(GLuint binding, size_t size);
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+	static bool isSupported();
+
+	void setData(const void* data, size_t size);
+	// uploads the data if it changed, then binds.
+	void update(RenderState& rs);
+	void bind();
+	void onGLContextRecreate();
+	~UniformBuffer();
+private:
+	std::vector<uint8_t> data;
+	GLuint id;
+	GLuint binding;
+	bool dirty;
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include "gl_context.h"
 #include "buffer_common.h"
 #include "shader_attribs.h"
+#include "vertex_layout.h"
 #include "util.h"
 
 struct VertexBuffer : public GLObject {
@@ -20,6 +21,9 @@ struct VertexBuffer : public GLObject {
 struct StaticVertexBuffer : VertexBuffer {
 	StaticVertexBuffer();
 	StaticVertexBuffer(const MemBlock& data, const char* fmt);
+	StaticVertexBuffer(const MemBlock& data, const VertexLayout& layout);
+	// data must stay alive as long as the buffer, it's re-uploaded on the next update().
+	void setData(const MemBlock& data);
 	virtual const ShaderAttribs& getShaderAttribs() const;
 	virtual GLint  getStride() const;
 	virtual size_t getSize() const;
@@ -29,30 +33,81 @@ struct StaticVertexBuffer : VertexBuffer {
 	~StaticVertexBuffer();
 private:
 	void parseAttribs(const char* fmt);
+	void init();
 	MemBlock data;
 	ShaderAttribs attrs;
 	GLint stride;
 	GLuint id;
+	bool dirty;
 };
 
 struct DynamicVertexBuffer : VertexBuffer {
 	DynamicVertexBuffer();
 	DynamicVertexBuffer(const char* fmt, size_t initial_capacity);
+	DynamicVertexBuffer(const VertexLayout& layout, size_t initial_capacity);
 	
 	template<class T>
 	void push(const T& vertex_data){
-		assert(sizeof(T) == stride);
-		
-		const char* p = reinterpret_cast<const char*>(&vertex_data);
-		
-		for(size_t i = 0; i < sizeof(T); ++i){
-			data.push_back(p[i]);
-		}
-		
-		stream_buf.mark();	
+		checkType<T>();
+
+		const size_t off = stream_buf.append(sizeof(T));
+		memcpy(data.data() + off, &vertex_data, sizeof(T));
+
+		stream_buf.mark();
+	}
+
+	// appends n vertices with a single allocation + copy.
+	template<class T>
+	void push_n(const T* verts, size_t n){
+		checkType<T>();
+		if(n == 0) return;
+
+		const size_t off = stream_buf.append(n * sizeof(T));
+		memcpy(data.data() + off, verts, n * sizeof(T));
+
+		stream_buf.mark();
 	}
 
-	void invalidate(BufferRange&& range);
+	template<class T>
+	void push_range(const T* begin, const T* end){
+		push_n(begin, end - begin);
+	}
+
+	// appends n vertices and returns them to be written in place.
+	template<class T>
+	BufferSpan<T> reserve_append(size_t n){
+		checkType<T>();
+
+		const size_t off = stream_buf.append(n * sizeof(T));
+		stream_buf.mark();
+
+		return BufferSpan<T>{ reinterpret_cast<T*>(data.data() + off), n };
+	}
+
+	// like replace, for n already allocated vertices starting at index, marked dirty once.
+	template<class T>
+	BufferSpan<T> write(size_t index, size_t n){
+		checkType<T>();
+		assert((index + n) * stride <= data.size());
+
+		stream_buf.mark(index * stride, n * stride);
+
+		return BufferSpan<T>{ reinterpret_cast<T*>(data.data() + index * stride), n };
+	}
+
+	template<class T>
+	void replace(size_t index, const T& vertex_data){
+		checkType<T>();
+		assert((index + 1) * stride <= data.size());
+
+		memcpy(data.data() + index * stride, &vertex_data, sizeof(T));
+		stream_buf.mark(index * stride, sizeof(T));
+	}
+
+	// alloc / extend / free work in whole vertices, and never move existing ones.
+	size_t alloc(size_t count);
+	bool extend(size_t index, size_t count, size_t new_count);
+	void free(size_t index, size_t count);
 	
 	void clear();
 	
@@ -63,11 +118,21 @@ struct DynamicVertexBuffer : VertexBuffer {
 	virtual GLuint getID() const;
 	virtual void update(RenderState&);
 
-	~DynamicVertexBuffer(){};
+	~DynamicVertexBuffer(){
+		gl.waitForFrame();
+	};
 private:
+	// buffers made from a VertexLayout only accept the struct they were made for.
+	template<class T>
+	void checkType() const {
+		assert(sizeof(T) == stride);
+		assert(!type_tag || type_tag == VertexLayout::tagOf<T>());
+	}
+
 	std::vector<uint8_t> data;
 	ShaderAttribs attrs;
 	GLint stride;
+	const void* type_tag;
 	StreamingBuffer stream_buf;
 };
 
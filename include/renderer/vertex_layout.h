@@ -0,0 +1,144 @@
+#ifndef VERTEX_LAYOUT_H_
+#define VERTEX_LAYOUT_H_
+#include "common.h"
+#include "gl_context.h"
+#include "shader_attribs.h"
+#include "util.h"
+#include <cstddef>
+#include <array>
+
+/* Vertex formats described by the vertex struct itself, instead of a format string.
+
+   VERTEX_LAYOUT(text_layout, TextVert,
+       VATTR(TextVert, x,     "a_pos", 2),
+       VATTR(TextVert, tex_x, "a_tex", 2, ATR_NORM),
+       VATTR(TextVert, color, "a_col", 4, ATR_NORM)
+   );
+
+   The GL type of each attribute comes from the member's type, the offset from offsetof,
+   and a static_assert checks the attributes cover the whole struct, so the stride can't
+   drift out of sync with sizeof(T) when the struct changes. */
+
+struct VertexAttrib {
+	uint32_t name_hash;
+	GLenum type;
+	int nelem, off;
+	uint32_t flags;
+
+	constexpr int size() const {
+		return (type == GL_BYTE || type == GL_UNSIGNED_BYTE) ? 1
+		     : (type == GL_SHORT || type == GL_UNSIGNED_SHORT) ? 2
+		     : (type == GL_DOUBLE) ? 8
+		     : 4;
+	}
+
+	// each attribute takes up a multiple of 4 bytes, same as the format strings.
+	constexpr int end() const {
+		return (off + nelem * size() + 3) & ~3;
+	}
+
+	constexpr bool valid() const {
+		return type != 0 && nelem > 0 && nelem <= 4 && (off & 3) == 0;
+	}
+};
+
+namespace vertex_layout_detail {
+
+template<class T> struct gl_type       { enum : GLenum { value = 0 }; };
+template<> struct gl_type<int8_t>      { enum : GLenum { value = GL_BYTE }; };
+template<> struct gl_type<uint8_t>     { enum : GLenum { value = GL_UNSIGNED_BYTE }; };
+template<> struct gl_type<int16_t>     { enum : GLenum { value = GL_SHORT }; };
+template<> struct gl_type<uint16_t>    { enum : GLenum { value = GL_UNSIGNED_SHORT }; };
+template<> struct gl_type<int32_t>     { enum : GLenum { value = GL_INT }; };
+template<> struct gl_type<uint32_t>    { enum : GLenum { value = GL_UNSIGNED_INT }; };
+template<> struct gl_type<float>       { enum : GLenum { value = GL_FLOAT }; };
+template<> struct gl_type<double>      { enum : GLenum { value = GL_DOUBLE }; };
+
+template<class T> struct void_type { typedef void type; };
+
+// arrays, std::array and glm vectors give their element type, scalars give themselves.
+template<class M, class = void>
+struct elem_type { typedef M type; };
+
+template<class M, size_t N>
+struct elem_type<M[N], void> { typedef M type; };
+
+template<class M>
+struct elem_type<M, typename void_type<typename M::value_type>::type> {
+	typedef typename M::value_type type;
+};
+
+template<class T>
+struct type_tag {
+	static const char id;
+};
+
+template<class T>
+const char type_tag<T>::id = 0;
+
+template<class M>
+constexpr VertexAttrib make_attrib(uint32_t hash, size_t off, int nelem, uint32_t flags = 0){
+	return VertexAttrib{
+		hash,
+		gl_type<typename elem_type<M>::type>::value,
+		nelem,
+		int(off),
+		flags
+	};
+}
+
+constexpr int extent(const VertexAttrib* a, size_t n){
+	return n == 0 ? 0 : a->end() > extent(a + 1, n - 1) ? a->end() : extent(a + 1, n - 1);
+}
+
+constexpr bool valid(const VertexAttrib* a, size_t n){
+	return n == 0 || (a->valid() && valid(a + 1, n - 1));
+}
+
+}
+
+struct VertexLayout {
+	constexpr VertexLayout(const VertexAttrib* attribs, size_t count, GLint stride, const void* tag)
+	: attribs(attribs)
+	, count(count)
+	, stride(stride)
+	, tag(tag){
+
+	}
+
+	constexpr int extent() const {
+		return vertex_layout_detail::extent(attribs, count);
+	}
+
+	constexpr bool valid() const {
+		return vertex_layout_detail::valid(attribs, count);
+	}
+
+	template<class T>
+	static constexpr const void* tagOf(){
+		return &vertex_layout_detail::type_tag<T>::id;
+	}
+
+	void apply(ShaderAttribs& attrs) const;
+
+	const VertexAttrib* attribs;
+	size_t count;
+	GLint stride;
+	const void* tag;
+};
+
+template<class T, size_t N>
+constexpr VertexLayout make_vertex_layout(const VertexAttrib (&attribs)[N]){
+	return VertexLayout(attribs, N, sizeof(T), VertexLayout::tagOf<T>());
+}
+
+#define VATTR(T, member, name, ...) \
+	vertex_layout_detail::make_attrib<decltype(T::member)>(str_hash(name), offsetof(T, member), __VA_ARGS__)
+
+#define VERTEX_LAYOUT(layout, T, ...) \
+	constexpr VertexAttrib layout##_attribs[] = { __VA_ARGS__ }; \
+	constexpr VertexLayout layout = make_vertex_layout<T>(layout##_attribs); \
+	static_assert(layout.valid(), "Vertex layout for " #T " has an unsupported attribute."); \
+	static_assert(layout.extent() == sizeof(T), "Vertex layout for " #T " doesn't match its size.")
+
+#endif
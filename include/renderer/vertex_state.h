@@ -4,23 +4,65 @@
 #include "gl_context.h"
 #include "shader_attribs.h"
 #include <bitset>
+#include <vector>
+#include <atomic>
 
+/* Attribute bindings are resolved once per (program, VertexState) pair and cached.
+   With VAOs each pair gets its own VAO, so drawing with a pair seen before is a single
+   BindVertexArray. Without them, setup is skipped while the same pair stays bound.
+
+   The cache and its VAOs belong to whichever thread draws: with r_threaded that's the
+   render thread, so the main thread only bumps the serial to invalidate them, and VAOs
+   of deleted VertexStates are handed over to be deleted in the render context. */
 struct VertexState : public GLObject {
 	VertexState();
 	void setVertexBuffers(std::initializer_list<VertexBuffer*> buffers);
 	void setIndexBuffer(IndexBuffer* buff);
 	IndexBuffer* getIndexBuffer(void);
-	void setAttribArrays(RenderState& rs, const ShaderAttribs& attrs);
+	void setAttribArrays(RenderState& rs, GLuint program, const ShaderAttribs& attrs);
 	void bind(RenderState& rs);
+	// uploads any changes to the buffers, done separately from bind for the render thread.
+	void update(RenderState& rs);
 	void onGLContextRecreate();
 	~VertexState();
+
+	// set while a render thread owns the VAOs, so the destructor queues them up instead.
+	static void deferVAODeletes(bool defer);
+	// moves the queued VAO names into out, to be deleted by the thread drawing.
+	static void takeDeadVAOs(std::vector<GLuint>& out);
 private:
-	std::bitset<16> enabled_arrays; //TODO: use vector<bool> + lookup GL_MAX_VERTEX_ATTRIBS
-	ShaderAttribs active_attribs;
+	struct AttribBinding {
+		uint32_t name_hash;
+		GLint index;
+		size_t buffer;
+	};
+
+	struct Binding {
+		GLuint program;
+		GLuint vao;
+		std::vector<GLuint> buffer_ids; // to notice buffers getting new GL names.
+		std::vector<AttribBinding> attribs;
+		std::bitset<16> enabled;        //TODO: use vector<bool> + lookup GL_MAX_VERTEX_ATTRIBS
+		uint32_t serial;                // of the VertexState when it was resolved.
+	};
+
+	Binding* findBinding(GLuint program);
+	bool isStale(const Binding& b) const;
+	void resolve(Binding& b, const ShaderAttribs& attrs);
+	void setupVAO(RenderState& rs, Binding& b);
+	void apply(RenderState& rs, Binding& b);
+	void invalidate();
+
+	std::vector<Binding> bindings;
 	std::vector<VertexBuffer*> vertex_buffers;
 	IndexBuffer* index_buffer;
-	GLuint id;
+	GLuint current_vao;
+	std::atomic<uint32_t> serial;
 	bool using_vao;
+
+	static uint32_t next_serial;
+	static bool defer_deletes;
+	static std::vector<GLuint> dead_vaos;
 };
 
 #endif
@@ -62,6 +62,11 @@ struct Resource : ResourceBase {
 		return resource != nullptr;
 	}
 
+	// false while a loaded resource is still finishing asynchronously (e.g. Texture2D).
+	bool isReady() const {
+		return resource && is_ready(*resource, 0);
+	}
+
 	bool forceReload(){
 		if(!resource){
 			return load();
@@ -107,6 +112,16 @@ private:
 		log(logging::fatal, "Resource not found: %s", names.c_str());
 	}
 
+	template<class U>
+	static auto is_ready(const U& u, int) -> decltype(u.isReady()) {
+		return u.isReady();
+	}
+
+	template<class U>
+	static bool is_ready(const U&, long){
+		return true;
+	}
+
 	template<class U>
 	struct needs_engine_param {
 		template<class V> static std::true_type
@@ -45,10 +45,15 @@ ResourceHandle make_resource(const T& data){
 
 struct ResourceSystem {
 
-	ResourceSystem(const char* argv0);
+	ResourceSystem(const char* argv0, const char* app_name = "engine");
 
 	ResourceHandle load(const char* name);
 
+	// files in the per-user write dir. These bypass the resource map, so they are
+	// safe to call from worker threads, and are never cached in memory.
+	ResourceHandle loadUserFile(const char* name);
+	bool saveUserFile(const char* name, MemBlock data);
+
 	size_t getUseCount(const char* name);
 
 	~ResourceSystem();
@@ -115,6 +120,7 @@ struct ResourceSystem {
 private:
 	ResourceHandle import(const char* name);
 	std::map<strhash_t, ResourceHandle> resources;
+	bool has_write_dir;
 };
 
 #endif
@@ -2,12 +2,23 @@
 #define ROOT_STATE_H_
 #include "common.h"
 #include "game_state.h"
+#include "resource.h"
+#include "font.h"
+#include "text.h"
 
 struct RootState : public GameState {
 	RootState(Engine& e);
 	void update(Engine& e, uint32_t delta);
 	void draw(Renderer& r);
 	bool onInput(Engine& e, int action_id, bool pressed);
+private:
+	void updateStats();
+
+	Engine& engine;
+	CVarBool* stats_overlay;
+	Resource<Font, size_t> font;
+	Text stats_text;
+	uint32_t stats_time;
 };
 
 #endif
@@ -16,6 +16,9 @@ struct StateSystem {
 
 	void onResize(Engine& e, int w, int h);
 
+	bool hasStateChanges() const {
+		return !new_states.empty() || pop_num;
+	}
 	void processStateChanges(Engine& e);
 	void update(Engine& e, uint32_t delta);
 	void draw(Renderer& r);
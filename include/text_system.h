@@ -10,7 +10,7 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
-struct TextSystem : public BufferInvalidateListener {
+struct TextSystem {
 	TextSystem(Engine& e);
 	
 	FT_Library& getLib();
@@ -19,11 +19,9 @@ struct TextSystem : public BufferInvalidateListener {
 	void updateText(Text& t, const alt::StrRef32& newstr, glm::ivec2 newpos);
 	void delText(Text& t);
 
-	virtual void onBufferRangeInvalidated(size_t off, size_t len); 
-
 	~TextSystem();
 private:
-	size_t writeString(Text& t, glm::ivec2 pos, const alt::StrRef32& str);
+	size_t writeString(Text& t, size_t index, glm::ivec2 pos, const alt::StrRef32& str);
 
 	FT_Library ft_lib;
 	VertexState v_state;
@@ -31,6 +29,9 @@ private:
 	Resource<VertShader> text_vs;
 	Resource<FragShader> text_fs;
 	ShaderProgram text_shader;
+	Resource<VertShader> text_array_vs;
+	Resource<FragShader> text_array_fs;
+	ShaderProgram text_array_shader;
 	BlendMode blend_mode;
 
 	std::list<Renderable> text_renderables;
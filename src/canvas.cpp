@@ -10,8 +10,13 @@ struct LineVert {
 	std::array<uint8_t, 4> color;
 };
 
+VERTEX_LAYOUT(line_layout, LineVert,
+	VATTR(LineVert, x    , "a_pos", 2),
+	VATTR(LineVert, color, "a_col", 4, ATR_NORM)
+);
+
 Canvas::Canvas(Engine& e)
-: vertices("a_pos:2s|a_col:4BN", 32)
+: vertices(line_layout, 32)
 , vstate()
 , vs(e, { "color.glslv" })
 , fs(e, { "color.glslf" })
@@ -29,8 +34,9 @@ void Canvas::addLine(vec2 from, vec2 to, uint32_t color){
 		uint8_t(color)
 	}};
 	
-	vertices.push(LineVert(from.x, from.y, c));
-	vertices.push(LineVert(to.x  , to.y  , c));
+	BufferSpan<LineVert> v = vertices.reserve_append<LineVert>(2);
+	v[0] = LineVert(from.x, from.y, c);
+	v[1] = LineVert(to.x  , to.y  , c);
 
 	lines.count += 2;
 }
@@ -45,17 +51,14 @@ void Canvas::addBox(vec2 pos, vec2 size, uint32_t color){
 
 	size_t w = size.x / 2, h = size.y / 2;
 
-	vertices.push(LineVert(pos.x - w, pos.y - h, c));
-	vertices.push(LineVert(pos.x + w, pos.y - h, c));
-
-	vertices.push(LineVert(pos.x + w, pos.y - h, c));
-	vertices.push(LineVert(pos.x + w, pos.y + h, c));
-	
-	vertices.push(LineVert(pos.x + w, pos.y + h, c));
-	vertices.push(LineVert(pos.x - w, pos.y + h, c));
+	const LineVert box[] = {
+		LineVert(pos.x - w, pos.y - h, c), LineVert(pos.x + w, pos.y - h, c),
+		LineVert(pos.x + w, pos.y - h, c), LineVert(pos.x + w, pos.y + h, c),
+		LineVert(pos.x + w, pos.y + h, c), LineVert(pos.x - w, pos.y + h, c),
+		LineVert(pos.x - w, pos.y + h, c), LineVert(pos.x - w, pos.y - h, c)
+	};
 
-	vertices.push(LineVert(pos.x - w, pos.y + h, c));
-	vertices.push(LineVert(pos.x - w, pos.y - h, c));
+	vertices.push_range(std::begin(box), std::end(box));
 
 	lines.count += 8;
 }
@@ -4,6 +4,7 @@
 #include "font.h"
 #include "input.h"
 #include "state_system.h"
+#include "renderer.h"
 #include <numeric>
 
 enum {
@@ -362,7 +363,10 @@ void CLI::update(Engine& e, uint32_t delta){
 void CLI::draw(Renderer& r){
 	if(!active) return;
 	
+	r.setLayer(Renderer::LAYER_UI);
+	r.setLabel("cli_bg");
 	bg_batch.draw(r);
+	r.setLabel("cli_text");
 	
 	// draw the input line + cursor if not scrolled up.
 	if(input_dirty){
@@ -405,6 +409,8 @@ void CLI::draw(Renderer& r){
 		output_dirty = false;
 	}
 	output_text.draw(r);
+	r.setLabel(nullptr);
+	r.setLayer(Renderer::LAYER_SCENE);
 }
 
 void CLI::echo(const alt::StrRef& str){
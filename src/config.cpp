@@ -52,6 +52,11 @@ static struct Args {
 		[](Config& c, ArgContext& ctx){
 			c.evalVar("vid_fullscreen", "0", true);
 		}
+	}, {
+		{"-hl"}, {"--headless"}, nullptr,
+		[](Config& c, ArgContext& ctx){
+			c.evalVar("vid_headless", "1", true);
+		}
 	}, {
 		{"-r"}, {"--resolution"}, "<width> <height>",
 		[](Config& c, ArgContext& ctx){
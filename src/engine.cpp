@@ -8,6 +8,7 @@
 #include "state_system.h"
 #include "root_state.h"
 #include "cli.h"
+#include "job_system.h"
 #include <algorithm>
 #include <clocale>
 
@@ -29,7 +30,8 @@ Engine::Engine(int argc, char** argv, const char* name){
 
 	SDL_Init(0);
 
-	res        = make_unique<ResourceSystem>(argv[0]);
+	jobs       = make_unique<JobSystem>();
+	res        = make_unique<ResourceSystem>(argv[0], name);
 	cfg        = make_unique<Config>(*this, argc, argv);
 	input      = make_unique<Input>(*this);
 	renderer   = make_unique<Renderer>(*this, name);
@@ -64,6 +66,10 @@ bool Engine::run(void){
 
 	delta = std::min(delta, 100);
 
+	// states going away might own things the render thread is still drawing.
+	if(state->hasStateChanges()){
+		renderer->waitForFrame();
+	}
 	state->processStateChanges(*this);
 
 	SDL_Event e;
@@ -111,6 +117,10 @@ bool Engine::run(void){
 		
 	renderer->drawFrame();
 
+	if(!running){
+		renderer->waitForFrame();
+	}
+
 	TRACEF("---------- Frame End ----------");
 
 	return running;
@@ -121,6 +131,7 @@ void Engine::quit(){
 }
 
 Engine::~Engine(){
+	jobs.reset();
 	SDL_Quit();
 }
 
@@ -1,6 +1,7 @@
 #include "font.h"
 #include "engine.h"
 #include "text_system.h"
+#include "texture_atlas.h"
 #include <tuple>
 #include FT_STROKER_H
 
@@ -55,7 +56,12 @@ Font::Font(Engine& e, MemBlock mem, size_t h, uint16_t utf_lo, uint16_t utf_hi)
 , utf_lo(utf_lo)
 , utf_hi(utf_hi)
 , face(nullptr)
-, atlas() {
+, atlas()
+, pixels()
+, pixels_size()
+, array(nullptr)
+, array_size(0)
+, layer(0) {
 
 	FT_Library& ft_lib = e.text->getLib();
 	assert(FT_New_Memory_Face(ft_lib, mem.ptr, mem.size, 0, &face) == 0);
@@ -207,7 +213,9 @@ Font::Font(Engine& e, MemBlock mem, size_t h, uint16_t utf_lo, uint16_t utf_hi)
 		   combined_w = glyph_tex.w,
 		   combined_h = next_pow_of_2(glyph_tex.h);
 
-	uint8_t* combined = new uint8_t[combined_w * combined_h * 2]();
+	pixels.resize(combined_w * combined_h * 2);
+	pixels_size = glm::ivec2(combined_w, combined_h);
+	uint8_t* combined = pixels.data();
 
 	for(size_t i = 0; i < sz * 2; ++i){
 		combined[i] = (i % 2) ? outline_tex.mem[i/2] : glyph_tex.mem[i/2];
@@ -232,7 +240,29 @@ Font::Font(Engine& e, MemBlock mem, size_t h, uint16_t utf_lo, uint16_t utf_hi)
 
 	free(glyph_tex.mem);
 	free(outline_tex.mem);
-	delete [] combined;
+}
+
+bool Font::addToAtlas(TextureAtlas& ta){
+	if(!ta.getArray()){
+		log(logging::error, "Font: can only be added to a TextureAtlas created with use_array.");
+		return false;
+	}
+
+	// expanded the same way the swizzle does for the font's own texture.
+	std::vector<uint8_t> rgba(pixels.size() * 2);
+	for(size_t i = 0; i < pixels.size() / 2; ++i){
+		rgba[i*4+0] = rgba[i*4+1] = rgba[i*4+2] = pixels[i*2];
+		rgba[i*4+3] = pixels[i*2+1];
+	}
+
+	const int page = ta.addPage(rgba.data(), pixels_size.x, pixels_size.y);
+	if(page < 0) return false;
+
+	array = ta.getArray();
+	array_size = ta.getPageSize();
+	layer = page;
+
+	return true;
 }
 
 std::tuple<uint16_t, uint16_t> Font::getUTFRange() const {
@@ -243,10 +273,17 @@ size_t Font::getLineHeight() const {
 	return height;
 }
 
-const Texture2D* Font::getTexture() const {
+const Texture* Font::getTexture() const {
+	if(array) return array;
 	return &atlas;
 }
 
+glm::ivec2 Font::getTextureSize() const {
+	// glyphs keep their pixel positions in the page, only the scale changes.
+	if(array) return glm::ivec2(array_size, array_size);
+	return pixels_size;
+}
+
 const Font::GlyphInfo& Font::getGlyphInfo(char32_t c) const {
 	size_t idx = std::max<int>(0, (c + 1) - (int)utf_lo);
 	if(idx >= glyph_info.size()) idx = 0;
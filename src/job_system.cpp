@@ -0,0 +1,131 @@
+#include "job_system.h"
+#include <algorithm>
+#include <atomic>
+
+JobSystem::JobSystem(int num_threads)
+: threads()
+, queue()
+, lock(nullptr)
+, cond(nullptr)
+, done_cond(nullptr)
+, quit(false) {
+
+#ifdef __EMSCRIPTEN__
+	num_threads = 0;
+#else
+	if(num_threads < 0){
+		num_threads = std::min(std::max(SDL_GetCPUCount() - 1, 1), 4);
+	}
+#endif
+
+	if(num_threads == 0) return;
+
+	lock = SDL_CreateMutex();
+	cond = SDL_CreateCond();
+	done_cond = SDL_CreateCond();
+
+	for(int i = 0; i < num_threads; ++i){
+		if(SDL_Thread* t = SDL_CreateThread(&workerMain, "worker", this)){
+			threads.push_back(t);
+		} else {
+			log(logging::warn, "Couldn't create worker thread (%s).", SDL_GetError());
+			break;
+		}
+	}
+
+	DEBUGF("Job system started with %zu worker thread(s).", threads.size());
+}
+
+void JobSystem::submit(std::function<void()>&& job){
+	if(threads.empty()){
+		job();
+		return;
+	}
+
+	SDL_LockMutex(lock);
+	queue.push_back(std::move(job));
+	SDL_UnlockMutex(lock);
+	SDL_CondSignal(cond);
+}
+
+void JobSystem::parallelFor(size_t n, const std::function<void(size_t)>& fn){
+	if(threads.empty() || n <= 1){
+		for(size_t i = 0; i < n; ++i) fn(i);
+		return;
+	}
+
+	// helpers can start after everything is done and this has returned, so all they
+	// share with it lives here, and they only touch fn while there's work left.
+	struct State {
+		std::atomic<size_t> next, done;
+	};
+	auto state = std::make_shared<State>();
+	state->next = 0;
+	state->done = 0;
+
+	const std::function<void(size_t)>* fn_ptr = &fn;
+
+	auto work = [this, state, fn_ptr, n]{
+		size_t i;
+		while((i = state->next++) < n){
+			(*fn_ptr)(i);
+			if(++state->done == n){
+				SDL_LockMutex(lock);
+				SDL_CondBroadcast(done_cond);
+				SDL_UnlockMutex(lock);
+			}
+		}
+	};
+
+	const size_t helpers = std::min(threads.size(), n - 1);
+	for(size_t i = 0; i < helpers; ++i){
+		submit(work);
+	}
+
+	work();
+
+	SDL_LockMutex(lock);
+	while(state->done < n){
+		SDL_CondWait(done_cond, lock);
+	}
+	SDL_UnlockMutex(lock);
+}
+
+int JobSystem::workerMain(void* self){
+	JobSystem& js = *reinterpret_cast<JobSystem*>(self);
+
+	SDL_LockMutex(js.lock);
+	while(true){
+		while(!js.quit && js.queue.empty()){
+			SDL_CondWait(js.cond, js.lock);
+		}
+		if(js.quit) break;
+
+		std::function<void()> job = std::move(js.queue.front());
+		js.queue.pop_front();
+
+		SDL_UnlockMutex(js.lock);
+		job();
+		SDL_LockMutex(js.lock);
+	}
+	SDL_UnlockMutex(js.lock);
+
+	return 0;
+}
+
+JobSystem::~JobSystem(){
+	if(lock){
+		SDL_LockMutex(lock);
+		quit = true;
+		SDL_UnlockMutex(lock);
+		SDL_CondBroadcast(cond);
+	}
+
+	for(auto* t : threads){
+		SDL_WaitThread(t, nullptr);
+	}
+
+	if(done_cond) SDL_DestroyCond(done_cond);
+	if(cond) SDL_DestroyCond(cond);
+	if(lock) SDL_DestroyMutex(lock);
+}
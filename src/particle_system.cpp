@@ -0,0 +1,329 @@
+#include "particle_system.h"
+#include "engine.h"
+#include "renderer.h"
+#include "material.h"
+#include "job_system.h"
+#include "vertex_layout.h"
+#include <algorithm>
+
+namespace {
+
+struct ParticleInstance {
+	float x, y;
+	float size;
+	uint8_t col[4];
+};
+
+static_assert(sizeof(ParticleInstance) == 16, "ParticleInstance should be 16 bytes");
+
+VERTEX_LAYOUT(instance_layout, ParticleInstance,
+	VATTR(ParticleInstance, x   , "a_pos" , 2, ATR_INSTANCED),
+	VATTR(ParticleInstance, size, "a_size", 1, ATR_INSTANCED),
+	VATTR(ParticleInstance, col , "a_col" , 4, ATR_NORM | ATR_INSTANCED)
+);
+
+// the same attributes for drawing without instancing, one per corner of each quad.
+struct ParticleVertex {
+	float x, y;
+	float size;
+	uint8_t col[4];
+	uint8_t corner[4];
+};
+
+static_assert(sizeof(ParticleVertex) == 20, "ParticleVertex should be 20 bytes");
+
+VERTEX_LAYOUT(vertex_layout, ParticleVertex,
+	VATTR(ParticleVertex, x     , "a_pos"   , 2),
+	VATTR(ParticleVertex, size  , "a_size"  , 1),
+	VATTR(ParticleVertex, col   , "a_col"   , 4, ATR_NORM),
+	VATTR(ParticleVertex, corner, "a_corner", 2)
+);
+
+static const uint8_t quad_corners[4][4] = {
+	{ 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 }
+};
+
+// below this, splitting the work up costs more than it saves.
+static const size_t min_job_size = 8192;
+
+// GCC / clang vector extension, 4 floats at a time without needing 16 byte alignment.
+typedef float v4f __attribute__((vector_size(16), aligned(4), may_alias));
+
+static v4f& v4(float* p){
+	return *reinterpret_cast<v4f*>(p);
+}
+
+static void integrate(float* x, float* y, float* vx, float* vy, float* life,
+                      size_t begin, size_t end, float dt, glm::vec2 g){
+	const v4f vdt = { dt, dt, dt, dt };
+	const v4f gx  = vdt * g.x, gy = vdt * g.y;
+
+	size_t i = begin;
+	for(; i + 4 <= end; i += 4){
+		v4(vx + i)   += gx;
+		v4(vy + i)   += gy;
+		v4(x + i)    += v4(vx + i) * vdt;
+		v4(y + i)    += v4(vy + i) * vdt;
+		v4(life + i) -= vdt;
+	}
+	for(; i < end; ++i){
+		vx[i]   += g.x * dt;
+		vy[i]   += g.y * dt;
+		x[i]    += vx[i] * dt;
+		y[i]    += vy[i] * dt;
+		life[i] -= dt;
+	}
+}
+
+static bool can_instance(){
+	return gl.DrawElementsInstanced
+	    && (gl.VertexAttribFormat ? gl.VertexBindingDivisor : gl.VertexAttribDivisor);
+}
+
+}
+
+const size_t ParticleSystem::page_size;
+
+ParticleSystem::ParticleSystem(Engine& e, Material& m, ShaderProgram& inst_shader, size_t max_particles)
+: p()
+, count(0)
+, written(0)
+, max_particles(max_particles)
+, gravity(0.0f, 0.0f)
+, rng(0x9E3779B9)
+, emitters()
+, spawn_acc()
+, jobs(e.jobs.get())
+, instanced(can_instance())
+, vao()
+, corners()
+, instances()
+, indices(QuadIndexBuffer::get())
+, pages()
+, renderable(&inst_shader, &m.uniforms, RType{ GL_TRIANGLES }) {
+
+	for(auto* v : { &p.x, &p.y, &p.vx, &p.vy, &p.life, &p.inv_life, &p.size }){
+		v->resize(max_particles);
+	}
+	p.color.resize(max_particles);
+
+	renderable.textures[0] = m.texture;
+	renderable.samplers[0] = m.sampler;
+
+	if(instanced){
+		corners.reset(new StaticVertexBuffer(quad_corners, "a_corner:2B"));
+		instances.reset(new DynamicVertexBuffer(instance_layout, max_particles * sizeof(ParticleInstance)));
+
+		vao.setVertexBuffers({ corners.get(), instances.get() });
+		vao.setIndexBuffer(indices.get());
+		indices->reserve(1);
+
+		renderable.vertex_state = &vao;
+		renderable.count = 6;
+	}
+}
+
+ParticleSystem::Page::Page(const Renderable& r)
+: vao()
+, vertices(vertex_layout, page_size * 4 * sizeof(ParticleVertex))
+, renderable(r) {
+	renderable.vertex_state = &vao;
+}
+
+ParticleEmitter* ParticleSystem::addEmitter(const ParticleEmitter& params){
+	emitters.emplace_back(new ParticleEmitter(params));
+	spawn_acc.push_back(0.0f);
+	return emitters.back().get();
+}
+
+void ParticleSystem::delEmitter(ParticleEmitter* em){
+	for(size_t i = 0; i < emitters.size(); ++i){
+		if(emitters[i].get() == em){
+			emitters.erase(emitters.begin() + i);
+			spawn_acc.erase(spawn_acc.begin() + i);
+			return;
+		}
+	}
+}
+
+void ParticleSystem::burst(const ParticleEmitter& em, size_t n){
+	spawn(em, n);
+}
+
+// xorshift, only used from update() / burst() on the calling thread.
+float ParticleSystem::random(float lo, float hi){
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return lo + (hi - lo) * ((rng >> 8) * (1.0f / 16777216.0f));
+}
+
+void ParticleSystem::spawn(const ParticleEmitter& em, size_t n){
+	n = std::min(n, max_particles - count);
+
+	for(size_t i = count; i < count + n; ++i){
+		const float life = std::max(random(em.life_min, em.life_max), 0.001f);
+
+		p.x[i]        = em.pos.x;
+		p.y[i]        = em.pos.y;
+		p.vx[i]       = random(em.vel_min.x, em.vel_max.x);
+		p.vy[i]       = random(em.vel_min.y, em.vel_max.y);
+		p.life[i]     = life;
+		p.inv_life[i] = 1.0f / life;
+		p.size[i]     = em.size;
+		p.color[i]    = em.color;
+	}
+
+	count += n;
+}
+
+// swap-remove: the last particle moves into i.
+void ParticleSystem::kill(size_t i){
+	const size_t last = --count;
+
+	p.x[i]        = p.x[last];
+	p.y[i]        = p.y[last];
+	p.vx[i]       = p.vx[last];
+	p.vy[i]       = p.vy[last];
+	p.life[i]     = p.life[last];
+	p.inv_life[i] = p.inv_life[last];
+	p.size[i]     = p.size[last];
+	p.color[i]    = p.color[last];
+}
+
+void ParticleSystem::forRange(size_t n, const std::function<void(size_t, size_t)>& fn){
+	const size_t jobs_wanted = std::min(n / min_job_size, jobs->numThreads() + 1);
+
+	if(jobs_wanted <= 1){
+		fn(0, n);
+	} else {
+		jobs->parallelFor(jobs_wanted, [&](size_t j){
+			fn(j * n / jobs_wanted, (j + 1) * n / jobs_wanted);
+		});
+	}
+}
+
+void ParticleSystem::update(uint32_t delta){
+	const float dt = delta / 1000.0f;
+
+	forRange(count, [&](size_t begin, size_t end){
+		integrate(p.x.data(), p.y.data(), p.vx.data(), p.vy.data(), p.life.data(), begin, end, dt, gravity);
+	});
+
+	for(size_t i = 0; i < count; /**/){
+		if(p.life[i] <= 0.0f){
+			kill(i);
+		} else {
+			++i;
+		}
+	}
+
+	for(size_t i = 0; i < emitters.size(); ++i){
+		const ParticleEmitter& em = *emitters[i];
+		if(!em.active) continue;
+
+		spawn_acc[i] += em.rate * dt;
+		const size_t n = spawn_acc[i];
+		spawn_acc[i] -= n;
+
+		spawn(em, n);
+	}
+
+	if(instanced){
+		writeInstances();
+	} else {
+		writeVertices();
+	}
+	written = count;
+}
+
+void ParticleSystem::writeInstances(){
+	instances->clear();
+	instances->reserve_append<ParticleInstance>(count);
+
+	// rewritten in place every frame, so mark all of it instead of relying on the append.
+	BufferSpan<ParticleInstance> out = instances->write<ParticleInstance>(0, count);
+
+	forRange(count, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; ++i){
+			const uint32_t c = p.color[i];
+			const float fade = std::min(p.life[i] * p.inv_life[i], 1.0f);
+
+			ParticleInstance& inst = out[i];
+			inst.x      = p.x[i];
+			inst.y      = p.y[i];
+			inst.size   = p.size[i];
+			inst.col[0] = c >> 24;
+			inst.col[1] = c >> 16;
+			inst.col[2] = c >> 8;
+			inst.col[3] = (c & 0xFF) * fade;
+		}
+	});
+}
+
+void ParticleSystem::writeVertices(){
+	const size_t num_pages = (count + page_size - 1) / page_size;
+
+	// pages are kept once made, and only created here on the thread calling update().
+	while(pages.size() < num_pages){
+		pages.emplace_back(new Page(renderable));
+		Page& pg = *pages.back();
+		pg.vao.setVertexBuffers({ &pg.vertices });
+		pg.vao.setIndexBuffer(indices.get());
+	}
+
+	std::vector<BufferSpan<ParticleVertex>> out(num_pages);
+
+	for(size_t i = 0; i < pages.size(); ++i){
+		DynamicVertexBuffer& verts = pages[i]->vertices;
+		const size_t n = i < num_pages ? std::min(count - i * page_size, page_size) : 0;
+
+		verts.clear();
+		verts.reserve_append<ParticleVertex>(n * 4);
+		if(n) out[i] = verts.write<ParticleVertex>(0, n * 4);
+	}
+
+	indices->reserve(std::min(count, page_size));
+
+	forRange(count, [&](size_t begin, size_t end){
+		for(size_t i = begin; i < end; ++i){
+			const uint32_t c = p.color[i];
+			const float fade = std::min(p.life[i] * p.inv_life[i], 1.0f);
+
+			ParticleVertex* v = out[i / page_size].ptr + (i % page_size) * 4;
+			for(int j = 0; j < 4; ++j){
+				v[j].x         = p.x[i];
+				v[j].y         = p.y[i];
+				v[j].size      = p.size[i];
+				v[j].col[0]    = c >> 24;
+				v[j].col[1]    = c >> 16;
+				v[j].col[2]    = c >> 8;
+				v[j].col[3]    = (c & 0xFF) * fade;
+				v[j].corner[0] = quad_corners[j][0];
+				v[j].corner[1] = quad_corners[j][1];
+			}
+		}
+	});
+}
+
+void ParticleSystem::draw(Renderer& r){
+	draw(r.getCommandList());
+}
+
+// draws what the last update() wrote, bursts since then show up after the next one.
+void ParticleSystem::draw(CommandList& cl){
+	if(!written) return;
+
+	if(instanced){
+		renderable.instances = written;
+		cl.addRenderable(renderable);
+		return;
+	}
+
+	for(size_t i = 0; i * page_size < written; ++i){
+		Renderable& pr = pages[i]->renderable;
+		pr.blend_mode = renderable.blend_mode;
+		pr.count = std::min(written - i * page_size, page_size) * 6;
+		cl.addRenderable(pr);
+	}
+}
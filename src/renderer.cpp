@@ -4,15 +4,54 @@
 #include "config.h"
 #include "cli.h"
 #include "texture.h"
+#include "texture_loader.h"
 #include "sampler.h"
+#include "vertex_state.h"
+#include "shader.h"
+#include "job_system.h"
+#include "resource_system.h"
+#include "png_writer.h"
 #include <math.h>
 #include <climits>
 #define GLM_FORCE_RADIANS
 #include <glm/gtc/matrix_transform.hpp>
 
 Renderer::Renderer(Engine& e, const char* name)
-: renderables      ()
+: commands         ()
+, ui_commands      ()
+, current          (&commands)
+, job_lists        ()
+, jobs             (e.jobs.get())
 , render_state     ()
+, frame_stats      ()
+, upload_state     ()
+, render_stats     ()
+, packets          ()
+, next_packet      (0)
+, render_ctx       (nullptr)
+, render_thread    (nullptr)
+, frame_lock       (SDL_CreateMutex())
+, frame_cond       (SDL_CreateCond())
+, pending_frame    (nullptr)
+, render_quit      (false)
+, upload_vao       (0)
+, gpu_timer        ()
+, gpu_times        ()
+, gpu_frame_ms     (0.0f)
+, scene_target     ()
+, scene_scale      (1.0f)
+, cpu_frame_ms     (0.0f)
+, prev_frame_time  (0)
+, idle_time        (0)
+, scale_cooldown   (0)
+, capture          (false)
+, capture_once     (false)
+, capture_ready    (false)
+, capture_pixels   ()
+, capture_w        (0)
+, capture_h        (0)
+, screenshot_name  ()
+, res              (e.res.get())
 , gl_debug         (e.cfg->addVar<CVarBool>   ("gl_debug",          true))
 , gl_fwd_compat    (e.cfg->addVar<CVarBool>   ("gl_fwd_compat",     true))
 , gl_core_profile  (e.cfg->addVar<CVarBool>   ("gl_core_profile",   true))
@@ -21,17 +60,36 @@ Renderer::Renderer(Engine& e, const char* name)
 , window_height    (e.cfg->addVar<CVarInt>    ("vid_height",        480, 240, INT_MAX))
 , vsync            (e.cfg->addVar<CVarInt>    ("vid_vsync",         1, -2, 2))
 , fov              (e.cfg->addVar<CVarInt>    ("vid_fov",           90, 45, 135))
+, render_scale     (e.cfg->addVar<CVarFloat>  ("vid_render_scale",  1.0f, 0.25f, 2.0f))
+, dynamic_res      (e.cfg->addVar<CVarBool>   ("vid_dynamic_res",   false))
+, target_ms        (e.cfg->addVar<CVarFloat>  ("vid_target_ms",     16.6f, 1.0f, 100.0f))
+, min_scale        (e.cfg->addVar<CVarFloat>  ("vid_min_scale",     0.5f, 0.25f, 2.0f))
+, max_scale        (e.cfg->addVar<CVarFloat>  ("vid_max_scale",     1.0f, 0.25f, 2.0f))
 , display_index    (e.cfg->addVar<CVarInt>    ("vid_display_index", 0, 0, 100))
 , fullscreen       (e.cfg->addVar<CVarBool>   ("vid_fullscreen",    false))
 , resizable        (e.cfg->addVar<CVarBool>   ("vid_resizable",     true))
+, threaded         (e.cfg->addVar<CVarBool>   ("r_threaded",        false))
+, gpu_timers       (e.cfg->addVar<CVarBool>   ("r_gpu_timers",      true))
+, headless         (e.cfg->addVar<CVarBool>   ("vid_headless",      false))
 , window_title     (name)
 , window           (nullptr)
 , main_uniforms    ()
+, globals          ()
+, globals_ubo      ()
+, camera           ()
+, camera_version   (0)
+, tex_loader       (new TextureLoader(e))
 , window_w         (window_width->val)
 , window_h         (window_height->val) {
 
 	SDL_SetHint(SDL_HINT_VIDEO_MINIMIZE_ON_FOCUS_LOSS, "0");
 
+	// SDL's offscreen driver renders through an EGL pbuffer without a window system, so
+	// with Mesa's software rasteriser it works with no display or GPU at all.
+	if(headless->val){
+		SDL_setenv("SDL_VIDEODRIVER", "offscreen", 0);
+	}
+
 	if(SDL_InitSubSystem(SDL_INIT_VIDEO) != 0){
 		log(logging::fatal, "Couldn't initialize SDL video subsystem (%s).", SDL_GetError());
 	}
@@ -44,7 +102,8 @@ Renderer::Renderer(Engine& e, const char* name)
 	std::initializer_list<CVar*> reload_vars = {
 		gl_debug,      gl_fwd_compat, gl_core_profile, libgl,
 		window_width,  window_height, vsync,           fov,
-		display_index, fullscreen,    resizable
+		display_index, fullscreen,    resizable,       threaded,
+		gpu_timers
 	};
 
 	for(auto* v : reload_vars){
@@ -69,6 +128,30 @@ Renderer::Renderer(Engine& e, const char* name)
 		return true;
 	}, "Show info about available displays / monitors");
 
+	e.cfg->addVar<CVarFunc>("r_screenshot", [&](const alt::StrRef& name){
+		screenshot_name.assign(name.size() ? name : alt::StrRef("screenshot.png"));
+		capture_once = true;
+		capture_ready = false;
+		return true;
+	}, "Usage: r_screenshot [file name], saved to the user dir.");
+
+	e.cfg->addVar<CVarFunc>("r_stats", [&](const alt::StrRef&){
+		e.cli->printf("Uploaded: %zu bytes in %zu calls.",
+			frame_stats.bytes_uploaded,
+			frame_stats.buffer_uploads
+		);
+		e.cli->printf("Render scale: %.2f", scene_scale);
+		if(gpu_timer){
+			e.cli->printf("GPU: %.2f ms", gpu_frame_ms);
+			for(auto& t : gpu_times){
+				e.cli->printf("  %-12s %6.2f ms", t.label ? t.label : "(other)", t.ms);
+			}
+		} else {
+			e.cli->echo("GPU timers unavailable.");
+		}
+		return true;
+	}, "Show renderer stats for the last frame");
+
 	reload(e);
 }
 
@@ -76,6 +159,7 @@ void Renderer::reload(Engine& e){
 	//TODO: check if we can get away with just using SDL_SetWindow{Size, Position} e.t.c.
 	//      instead of destroying the window & GL context.
 
+	stopRenderThread();
 	gl.deleteContext();
 
 	if(window){
@@ -128,10 +212,10 @@ void Renderer::reload(Engine& e){
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, ctx_flags);
 #endif		
 		int window_flags = SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN;
-		if(fullscreen->val){
+		if(fullscreen->val && !headless->val){
 			window_flags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
 		}
-		if(resizable->val){
+		if(resizable->val && !headless->val){
 			window_flags |= SDL_WINDOW_RESIZABLE;
 		}
 
@@ -158,12 +242,147 @@ void Renderer::reload(Engine& e){
 	}
 
 	SDL_SetWindowMinimumSize(window, window_width->min, window_height->min);
-	SDL_ShowWindow(window);
+	if(!headless->val){
+		SDL_ShowWindow(window);
+	}
 
 	gl.Enable(GL_BLEND);
 	SDL_GL_SetSwapInterval(vsync->val);
+
+	// GL 2.x contexts only get the per-uniform path, see GlobalUniforms.
+	if(!UniformBuffer::isSupported()){
+		globals_ubo.reset();
+	} else if(!globals_ubo){
+		globals_ubo.reset(new UniformBuffer(GlobalUniforms::binding, sizeof(globals)));
+	}
 	
 	handleResize(window_width->val, window_height->val);
+
+	if(gpu_timers->val && GpuTimer::isSupported()){
+		if(!gpu_timer) gpu_timer.reset(new GpuTimer);
+	} else {
+		gpu_timer.reset();
+	}
+	gpu_times.clear();
+
+	if(Framebuffer::isSupported()){
+		if(!scene_target) scene_target.reset(new Framebuffer);
+	} else {
+		if(render_scale->val != 1.0f){
+			log(logging::warn, "vid_render_scale needs framebuffer blits, drawing at native resolution.");
+		}
+		scene_target.reset();
+	}
+
+	if(threaded->val){
+		startRenderThread();
+	}
+}
+
+void Renderer::startRenderThread(){
+#ifndef __EMSCRIPTEN__
+	render_ctx = gl.createSharedContext(window);
+	if(!render_ctx) return;
+
+	// core profiles need a VAO bound for the index buffer uploads done on this thread.
+	if(gl.GenVertexArrays){
+		gl.GenVertexArrays(1, &upload_vao);
+		gl.BindVertexArray(upload_vao);
+	}
+
+	upload_state = {};
+	upload_state.vao = upload_vao;
+	render_quit = false;
+
+	if((render_thread = SDL_CreateThread(&renderThreadMain, "render", this))){
+		VertexState::deferVAODeletes(true);
+		gl.renderer = this;
+	} else {
+		log(logging::warn, "Couldn't start render thread (%s).", SDL_GetError());
+		SDL_GL_DeleteContext(render_ctx);
+		render_ctx = nullptr;
+
+		if(upload_vao){
+			gl.DeleteVertexArrays(1, &upload_vao);
+			upload_vao = 0;
+		}
+	}
+#endif
+}
+
+void Renderer::stopRenderThread(){
+	if(!render_thread) return;
+
+	SDL_LockMutex(frame_lock);
+	render_quit = true;
+	SDL_CondBroadcast(frame_cond);
+	SDL_UnlockMutex(frame_lock);
+
+	SDL_WaitThread(render_thread, nullptr);
+	render_thread = nullptr;
+	gl.renderer = nullptr;
+
+	SDL_GL_DeleteContext(render_ctx);
+	render_ctx = nullptr;
+	VertexState::deferVAODeletes(false);
+
+	if(upload_vao){
+		gl.DeleteVertexArrays(1, &upload_vao);
+		upload_vao = 0;
+	}
+
+	// whatever the render thread had bound is gone with its context.
+	render_state = {};
+}
+
+int Renderer::renderThreadMain(void* self){
+	Renderer* r = reinterpret_cast<Renderer*>(self);
+
+	SDL_GL_MakeCurrent(r->window, r->render_ctx);
+	SDL_GL_SetSwapInterval(r->vsync->val);
+	gl.Enable(GL_BLEND);
+
+	r->render_state = {};
+
+	SDL_LockMutex(r->frame_lock);
+	while(true){
+		while(!r->pending_frame && !r->render_quit){
+			SDL_CondWait(r->frame_cond, r->frame_lock);
+		}
+		if(!r->pending_frame) break;
+
+		FramePacket* p = r->pending_frame;
+		SDL_UnlockMutex(r->frame_lock);
+
+		r->executeFrame(*p);
+
+		SDL_LockMutex(r->frame_lock);
+		r->pending_frame = nullptr;
+		SDL_CondBroadcast(r->frame_cond);
+	}
+	SDL_UnlockMutex(r->frame_lock);
+
+	// the queries and framebuffer object belong to this thread's context.
+	if(r->gpu_timer){
+		r->gpu_timer->clear();
+	}
+	if(r->scene_target){
+		r->scene_target->deleteFramebuffer();
+	}
+
+	SDL_GL_MakeCurrent(r->window, nullptr);
+	return 0;
+}
+
+void Renderer::waitForFrame(){
+	// the render thread would be waiting on itself.
+	if(!render_thread || SDL_ThreadID() == SDL_GetThreadID(render_thread)) return;
+
+	SDL_LockMutex(frame_lock);
+	while(pending_frame){
+		SDL_CondWait(frame_cond, frame_lock);
+	}
+	SDL_UnlockMutex(frame_lock);
 }
 
 void Renderer::handleResize(float w, float h){
@@ -173,76 +392,484 @@ void Renderer::handleResize(float w, float h){
 	if(gl.initialized()){
 		gl.Viewport(0, 0, w, h);
 
-		main_uniforms.setUniform("u_ortho", {
-			glm::ortho(0.f, w, h, 0.f)
-		});
+		globals.ortho = glm::ortho(0.f, w, h, 0.f);
+		main_uniforms.setUniform("u_ortho", { globals.ortho });
+
+		camera.setOrtho({ w, h });
+		globals.view = camera.getViewMatrix();
+		main_uniforms.setUniform("u_view", { globals.view });
+		camera_version = camera.getVersion();
 		
 		const float half_angle = (fov->val / 360.f) * M_PI;
 		const float x_dist = tan(half_angle);
 		const float y_dist = x_dist * (h/w);
 		
-		main_uniforms.setUniform("u_perspective", {
-			glm::frustum(-x_dist, x_dist, -y_dist, y_dist, 1.0f, 1000.0f)
-		});
+		globals.perspective = glm::frustum(-x_dist, x_dist, -y_dist, y_dist, 1.0f, 1000.0f);
+		main_uniforms.setUniform("u_perspective", { globals.perspective });
+
+		globals.viewport = glm::vec4(w, h, 1.0f / w, 1.0f / h);
+
+		if(globals_ubo){
+			globals_ubo->setData(&globals, sizeof(globals));
+		}
 	}
 }
 
-void Renderer::drawFrame(){
+void Renderer::updateCamera(){
+	const glm::mat4& view = camera.getViewMatrix();
+	if(camera_version != camera.getVersion()){
+		main_uniforms.setUniform("u_view", { view });
+		camera_version = camera.getVersion();
 
-	gl.Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		globals.view = view;
+		if(globals_ubo) globals_ubo->setData(&globals, sizeof(globals));
+	}
+}
 
-	for(auto i = renderables.begin(), j = renderables.end(); i != j; ++i){
-		auto* r = *i;
-		
-		VertexState* v = r->vertex_state;
-		if(!v) continue;
-		
-		r->blend_mode.bind(render_state);
+void Renderer::draw(RenderState& rs, Renderable& r, const ShaderUniforms& main_u, bool upload){
+	VertexState* v = r.vertex_state;
+	if(!v) return;
+	
+	r.blend_mode.bind(rs);
+	
+	if(ShaderProgram* s = r.shader){
+		s->bind(rs);
+		s->setAttribs(rs, *v);
+		if(!s->usesGlobals()){
+			s->setUniforms(main_u);
+		}
 		
-		if(ShaderProgram* s = r->shader){
-			s->bind(render_state);
-			s->setAttribs(render_state, *v);
-			s->setUniforms(main_uniforms);
+		if(ShaderUniforms* u = r.uniforms){
+			s->setUniforms(*u);
+		}
+	}
+	
+	for(size_t i = 0; i < r.textures.size(); ++i){
+		if(const Texture* t = r.textures[i]){
+			t->bind(i, rs);
+		}
+		if(const Sampler* s = r.samplers[i]){
+			s->bind(i, rs);
+		}
+	}
+	
+	v->bind(rs);
+	if(upload){
+		v->update(rs);
+	}
 			
-			if(ShaderUniforms* u = r->uniforms){
-				s->setUniforms(*u);
-			}
+	if(IndexBuffer* ib = v->getIndexBuffer()){
+		auto* off = reinterpret_cast<GLvoid*>(r.offset);
+		if(r.instances){
+			gl.DrawElementsInstanced(r.prim_type, r.count, ib->getType(), off, r.instances);
+		} else {
+			gl.DrawElements(r.prim_type, r.count, ib->getType(), off);
 		}
-		
-		for(size_t i = 0; i < r->textures.size(); ++i){
-			if(const Texture* t = r->textures[i]){
-				t->bind(i, render_state);
+	} else {
+		gl.DrawArrays(r.prim_type, r.offset, r.count);
+	}
+}
+
+namespace {
+	static const char no_group[] = "";
+}
+
+void Renderer::markGroup(const char*& group, const char* label){
+	if(gpu_timer && label != group){
+		gpu_timer->mark(label);
+		group = label;
+	}
+}
+
+void Renderer::readGpuTimes(){
+	if(gpu_timer){
+		gpu_times = gpu_timer->getResults();
+		gpu_frame_ms = gpu_timer->getFrameMs();
+	}
+}
+
+void Renderer::updateRenderScale(){
+	const uint64_t now = SDL_GetPerformanceCounter();
+	if(prev_frame_time){
+		// time blocked on the swap or the render thread is vsync rather than work. Counted
+		// in, it keeps the frame time near the target and the scale could never grow back.
+		const uint64_t busy = now - prev_frame_time - std::min(idle_time, now - prev_frame_time);
+		const float ms = busy * 1000.0f / SDL_GetPerformanceFrequency();
+		cpu_frame_ms = cpu_frame_ms * 0.9f + ms * 0.1f;
+	}
+	prev_frame_time = now;
+	idle_time = 0;
+
+	// without framebuffers the scene is always drawn straight to the window.
+	if(!scene_target){
+		scene_scale = 1.0f;
+		return;
+	}
+
+	if(!dynamic_res->val){
+		scene_scale = render_scale->val;
+		return;
+	}
+
+	const float lo = std::min(min_scale->val, max_scale->val);
+	const float hi = max_scale->val;
+
+	// GPU time if there is one, otherwise the CPU work time per frame.
+	const float ms = gpu_timer && gpu_frame_ms > 0.0f ? gpu_frame_ms : cpu_frame_ms;
+
+	// the measurements lag behind by a few frames, so give each change time to show up.
+	if(scale_cooldown > 0){
+		--scale_cooldown;
+	} else if(ms > 0.0f){
+		const float target = target_ms->val;
+		float next = scene_scale;
+
+		// cost goes with the pixel count, i.e. the square of the scale. Only growing
+		// once well under budget leaves a band in between where nothing changes.
+		if(ms > target * 1.05f){
+			next *= std::max(0.85f, sqrtf(target / ms));
+		} else if(ms < target * 0.8f){
+			next *= std::min(1.05f, sqrtf(target / ms));
+		}
+
+		next = clamp(next, lo, hi);
+		if(fabsf(next - scene_scale) >= 0.01f){
+			scene_scale = next;
+			scale_cooldown = 15;
+		}
+	}
+
+	scene_scale = clamp(scene_scale, lo, hi);
+}
+
+void Renderer::getSceneSize(int& w, int& h) const {
+	w = std::max(1, int(window_width->val * scene_scale + 0.5f));
+	h = std::max(1, int(window_height->val * scene_scale + 0.5f));
+}
+
+// sizes the scene target if the scene is drawn at something other than the window size.
+// has to happen on the main thread, since the colour texture is a GLObject.
+bool Renderer::prepareScene(RenderState& rs, int scene_w, int scene_h){
+	if(!scene_target) return false;
+
+	int target_w = scene_w, target_h = scene_h;
+
+	// sized for the largest scale, so changing it only changes how much gets used.
+	if(dynamic_res->val){
+		target_w = std::max(scene_w, int(window_width->val * max_scale->val + 0.5f));
+		target_h = std::max(scene_h, int(window_height->val * max_scale->val + 0.5f));
+	} else if(scene_w == window_width->val && scene_h == window_height->val){
+		return false;
+	}
+
+	if(scene_target->resize(target_w, target_h)){
+		rs.tex[rs.active_tex] = 0;
+	}
+	return true;
+}
+
+// binds the scene target if it's in use, falling back to the window if that fails.
+bool Renderer::beginScene(bool offscreen, int w, int h, int scene_w, int scene_h){
+	offscreen = offscreen && scene_target->bind();
+
+	if(offscreen){
+		gl.Viewport(0, 0, scene_w, scene_h);
+	} else {
+		gl.Viewport(0, 0, w, h);
+	}
+
+	gl.Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	return offscreen;
+}
+
+void Renderer::endScene(bool offscreen, int w, int h, int scene_w, int scene_h){
+	if(!offscreen) return;
+
+	// upscaling gets filtered, supersampled frames are just decimated.
+	scene_target->blitToDefault(scene_w, scene_h, w, h, scene_w < w ? GL_LINEAR : GL_NEAREST);
+	gl.Viewport(0, 0, w, h);
+}
+
+void Renderer::drawCommands(const CommandList& cl, const char*& group){
+	for(size_t i = 0; i < cl.size(); ++i){
+		markGroup(group, cl.getLabel(i));
+		draw(render_state, *cl.begin()[i], main_uniforms, true);
+	}
+}
+
+// reads back the window's back buffer, so has to happen before it's swapped.
+void Renderer::capturePixels(int w, int h){
+	const size_t row_sz = size_t(w) * 4;
+	capture_pixels.resize(row_sz * h);
+
+	gl.PixelStorei(GL_PACK_ALIGNMENT, 1);
+	gl.ReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, capture_pixels.data());
+
+	// GL's rows go bottom to top.
+	std::vector<uint8_t> row(row_sz);
+	for(int y = 0; y < h / 2; ++y){
+		uint8_t* a = capture_pixels.data() + y * row_sz;
+		uint8_t* b = capture_pixels.data() + (h - y - 1) * row_sz;
+		memcpy(row.data(), a, row_sz);
+		memcpy(a, b, row_sz);
+		memcpy(b, row.data(), row_sz);
+	}
+
+	capture_w = w;
+	capture_h = h;
+	capture_ready = true;
+}
+
+void Renderer::saveScreenshot(){
+	if(screenshot_name.empty() || !capture_ready) return;
+
+	std::vector<uint8_t> png;
+	png_encode(capture_pixels.data(), capture_w, capture_h, png);
+
+	if(res->saveUserFile(screenshot_name.c_str(), MemBlock(png.data(), png.size()))){
+		log(logging::info, "Saved screenshot %s.", screenshot_name.c_str());
+	} else {
+		log(logging::error, "Couldn't save screenshot %s.", screenshot_name.c_str());
+	}
+	screenshot_name.clear();
+}
+
+bool Renderer::readPixels(std::vector<uint8_t>& rgba, int& w, int& h){
+	waitForFrame();
+	if(!capture_ready) return false;
+
+	rgba = capture_pixels;
+	w = capture_w;
+	h = capture_h;
+	return true;
+}
+
+bool Renderer::isHeadless() const {
+	return headless->val;
+}
+
+void Renderer::drawFrame(){
+
+	updateRenderScale();
+
+	if(render_thread){
+		FramePacket& p = packets[next_packet];
+		next_packet ^= 1;
+
+		updateCamera();
+		recordFrame(p);
+
+		// everything the GPU sees has to be uploaded while the render thread is idle,
+		// since the buffers' CPU-side data is only stable in between frames.
+		const uint64_t wait_start = SDL_GetPerformanceCounter();
+		waitForFrame();
+		idle_time += SDL_GetPerformanceCounter() - wait_start;
+		saveScreenshot();
+
+		p.offscreen = prepareScene(upload_state, p.scene_w, p.scene_h);
+		p.capture = capture || capture_once;
+		capture_once = false;
+
+		tex_loader->update(upload_state);
+		if(globals_ubo){
+			globals_ubo->update(upload_state);
+		}
+		for(auto& r : p.renderables){
+			if(r.vertex_state) r.vertex_state->update(upload_state);
+		}
+
+		// the render context only sees the uploads once this context's commands are done.
+		if(gl.FenceSync){
+			p.fence = gl.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			gl.Flush();
+		} else {
+			gl.Finish();
+		}
+
+		frame_stats = upload_state.stats;
+		frame_stats.bytes_uploaded += render_stats.bytes_uploaded;
+		frame_stats.buffer_uploads += render_stats.buffer_uploads;
+		upload_state.stats = {};
+		readGpuTimes();
+
+		SDL_LockMutex(frame_lock);
+		pending_frame = &p;
+		SDL_CondBroadcast(frame_cond);
+		SDL_UnlockMutex(frame_lock);
+
+		commands.clear();
+		ui_commands.clear();
+		current = &commands;
+		return;
+	}
+
+	int scene_w, scene_h;
+	getSceneSize(scene_w, scene_h);
+	bool offscreen = prepareScene(render_state, scene_w, scene_h);
+	offscreen = beginScene(offscreen, window_width->val, window_height->val, scene_w, scene_h);
+
+	tex_loader->update(render_state);
+
+	updateCamera();
+
+	if(globals_ubo){
+		globals_ubo->update(render_state);
+	}
+
+	if(gpu_timer) gpu_timer->beginFrame();
+	const char* group = no_group;
+
+	drawCommands(commands, group);
+	endScene(offscreen, window_width->val, window_height->val, scene_w, scene_h);
+	drawCommands(ui_commands, group);
+
+	if(gpu_timer){
+		gpu_timer->endFrame();
+		readGpuTimes();
+	}
+
+	if(capture || capture_once){
+		capturePixels(window_width->val, window_height->val);
+		capture_once = false;
+		saveScreenshot();
+	}
+
+	const uint64_t swap_start = SDL_GetPerformanceCounter();
+	SDL_GL_SwapWindow(window);
+	idle_time += SDL_GetPerformanceCounter() - swap_start;
+
+	commands.clear();
+	ui_commands.clear();
+	current = &commands;
+
+	frame_stats = render_state.stats;
+	render_state.stats = {};
+}
+
+void Renderer::recordFrame(FramePacket& p){
+	p.renderables.clear();
+	p.labels.clear();
+	p.uniform_index.clear();
+	p.main_uniforms.snapshot(main_uniforms);
+	p.width = window_width->val;
+	p.height = window_height->val;
+	getSceneSize(p.scene_w, p.scene_h);
+	p.offscreen = false;
+	p.capture = false;
+	p.num_scene = commands.size();
+	p.fence = nullptr;
+	p.dead_vaos.clear();
+	VertexState::takeDeadVAOs(p.dead_vaos);
+
+	// uniforms shared between renderables are only copied once.
+	size_t num_uniforms = 0;
+	for(const CommandList* cl : { &commands, &ui_commands }){
+		for(auto* r : *cl){
+			if(r->uniforms && p.uniform_index.emplace(r->uniforms, num_uniforms).second){
+				if(p.uniforms.size() <= num_uniforms){
+					p.uniforms.emplace_back();
+				}
+				p.uniforms[num_uniforms++].snapshot(*r->uniforms);
 			}
-			if(const Sampler* s = r->samplers[i]){
-				s->bind(i, render_state);
+		}
+	}
+
+	// the UI goes after the scene, from index num_scene on.
+	for(const CommandList* cl : { &commands, &ui_commands }){
+		for(size_t i = 0; i < cl->size(); ++i){
+			p.labels.push_back(cl->getLabel(i));
+		}
+
+		for(auto* r : *cl){
+			p.renderables.push_back(*r);
+			if(r->uniforms){
+				p.renderables.back().uniforms = &p.uniforms[p.uniform_index[r->uniforms]];
 			}
 		}
-		
-		v->bind(render_state);
-				
-		if(IndexBuffer* ib = v->getIndexBuffer()){
-			gl.DrawElements(r->prim_type, r->count, ib->getType(), reinterpret_cast<GLvoid*>(r->offset));
-		} else {
-			gl.DrawArrays(r->prim_type, r->offset, r->count);
+	}
+}
+
+void Renderer::executeFrame(FramePacket& p){
+	if(p.fence){
+		gl.WaitSync(p.fence, 0, GL_TIMEOUT_IGNORED);
+		gl.DeleteSync(p.fence);
+		p.fence = nullptr;
+	}
+
+	if(!p.dead_vaos.empty()){
+		gl.DeleteVertexArrays(p.dead_vaos.size(), p.dead_vaos.data());
+	}
+
+	bool offscreen = beginScene(p.offscreen, p.width, p.height, p.scene_w, p.scene_h);
+
+	if(globals_ubo){
+		globals_ubo->bind();
+	}
+
+	if(gpu_timer) gpu_timer->beginFrame();
+	const char* group = no_group;
+
+	for(size_t i = 0; i < p.renderables.size(); ++i){
+		if(i == p.num_scene){
+			endScene(offscreen, p.width, p.height, p.scene_w, p.scene_h);
+			offscreen = false;
 		}
+		markGroup(group, p.labels[i]);
+		draw(render_state, p.renderables[i], p.main_uniforms, false);
+	}
+
+	endScene(offscreen, p.width, p.height, p.scene_w, p.scene_h);
+
+	if(gpu_timer) gpu_timer->endFrame();
+
+	if(p.capture){
+		capturePixels(p.width, p.height);
 	}
 
-	
 	SDL_GL_SwapWindow(window);
-	renderables.clear();
+
+	render_stats = render_state.stats;
+	render_state.stats = {};
 }
 
 void Renderer::addRenderable(Renderable& r){
-	renderables.push_back(&r);
+	current->addRenderable(r);
+}
+
+void Renderer::submit(const CommandList& cl){
+	current->append(cl);
+}
+
+void Renderer::recordParallel(size_t n, const std::function<void(size_t, CommandList&)>& fn){
+	while(job_lists.size() < n){
+		job_lists.emplace_back(new CommandList);
+	}
+
+	// its visibility checks update it lazily, which can't happen from several jobs at once.
+	camera.update();
+
+	jobs->parallelFor(n, [&](size_t i){
+		job_lists[i]->clear();
+		fn(i, *job_lists[i]);
+	});
+
+	// in index order, whichever job finished first, so the draw order is deterministic.
+	for(size_t i = 0; i < n; ++i){
+		submit(*job_lists[i]);
+	}
 }
 
 Renderer::~Renderer(){
+	stopRenderThread();
 	gl.deleteContext();
 	
 	if(window){
 		SDL_DestroyWindow(window);
 	}
 
+	SDL_DestroyCond(frame_cond);
+	SDL_DestroyMutex(frame_lock);
+
 	SDL_GL_UnloadLibrary();
 	SDL_QuitSubSystem(SDL_INIT_VIDEO);
 }
@@ -5,35 +5,148 @@
 #include <algorithm>
 
 namespace {
-using namespace std;
 
-static bool biggest_off_first(const BufferRange& a, const BufferRange& b){
-	return a.off > b.off;
+// dirty ranges closer together than this are uploaded as one, re-sending a few
+// unchanged bytes is cheaper than the overhead of another upload call.
+static const size_t merge_gap = 256;
+
+static void coalesce_ranges(std::vector<BufferRange>& ranges, size_t size){
+	std::sort(ranges.begin(), ranges.end(), [](const BufferRange& a, const BufferRange& b){
+		return a.off < b.off;
+	});
+
+	auto out = ranges.begin();
+	for(auto& r : ranges){
+		if(r.off >= size) break;
+		const size_t end = std::min(r.off + r.len, size);
+
+		if(out != ranges.begin()){
+			BufferRange& prev = *(out - 1);
+			if(r.off <= prev.off + prev.len + merge_gap){
+				prev.len = std::max(prev.len, end - prev.off);
+				continue;
+			}
+		}
+
+		*out++ = BufferRange{ r.off, end - r.off };
+	}
+	ranges.erase(out, ranges.end());
 }
 
-static void tidy_buffer(vector<uint8_t>& data, vector<BufferRange>& del_ranges, size_t& unused_bytes){
-	//XXX: handle overlapping ranges correctly
+}
 
-	sort(del_ranges.begin(), del_ranges.end(), &biggest_off_first);
+BufferAllocator::BufferAllocator()
+: free_by_off()
+, free_by_len()
+, end(0) {
 
-	for(auto& r : del_ranges){
-		data.erase(data.begin() + r.off, data.begin() + r.off + r.len);
+}
 
-		if(r.callback){
-			r.callback->onBufferRangeInvalidated(r.off, r.len);
-		}
+size_t BufferAllocator::alloc(size_t len){
+	if(len == 0) return end;
+
+	// smallest free block that fits, split off whatever is left over.
+	auto it = free_by_len.lower_bound(len);
+	if(it == free_by_len.end()){
+		return append(len);
+	}
+
+	const size_t off = it->second, block_len = it->first;
+	free_by_len.erase(it);
+	free_by_off.erase(off);
+
+	if(block_len > len){
+		addFree(off + len, block_len - len);
+	}
+
+	return off;
+}
+
+size_t BufferAllocator::append(size_t len){
+	const size_t off = end;
+	end += len;
+	return off;
+}
+
+bool BufferAllocator::extend(const BufferRange& r, size_t new_len){
+	if(new_len <= r.len){
+		free(BufferRange{ r.off + new_len, r.len - new_len });
+		return true;
+	}
+
+	const size_t r_end = r.off + r.len, extra = new_len - r.len;
+
+	if(r_end == end){
+		end += extra;
+		return true;
+	}
+
+	auto it = free_by_off.find(r_end);
+	if(it != free_by_off.end() && it->second >= extra){
+		const size_t len = it->second;
+		delFree(it);
+		if(len > extra) addFree(r_end + extra, len - extra);
+		return true;
 	}
 
-	del_ranges.clear();
-	unused_bytes = 0;
+	return false;
 }
 
+void BufferAllocator::free(const BufferRange& r){
+	if(r.len == 0) return;
+
+	size_t off = r.off, len = r.len;
+
+	auto next = free_by_off.lower_bound(off);
+	auto prev = next == free_by_off.begin() ? free_by_off.end() : std::prev(next);
+
+	if(next != free_by_off.end() && next->first == off + len){
+		len += next->second;
+		delFree(next);
+	}
+
+	if(prev != free_by_off.end() && prev->first + prev->second == off){
+		off = prev->first;
+		len += prev->second;
+		delFree(prev);
+	}
+
+	// free blocks never touch the end, it just moves back instead.
+	if(off + len == end){
+		end = off;
+	} else {
+		addFree(off, len);
+	}
+}
+
+void BufferAllocator::clear(){
+	free_by_off.clear();
+	free_by_len.clear();
+	end = 0;
+}
+
+void BufferAllocator::addFree(size_t off, size_t len){
+	free_by_off.emplace(off, len);
+	free_by_len.emplace(len, off);
+}
+
+void BufferAllocator::delFree(std::map<size_t, size_t>::iterator it){
+	auto range = free_by_len.equal_range(it->second);
+	for(auto i = range.first; i != range.second; ++i){
+		if(i->second == it->first){
+			free_by_len.erase(i);
+			break;
+		}
+	}
+	free_by_off.erase(it);
 }
 
 StreamingBuffer::StreamingBuffer()
 : data(nullptr)
+, allocator()
 , id(0)
 , type(0)
+, dirty_ranges()
 , prev_size(0)
 , prev_capacity(0)
 , dirty(false)
@@ -43,29 +156,81 @@ StreamingBuffer::StreamingBuffer()
 
 StreamingBuffer::StreamingBuffer(GLenum type, std::vector<uint8_t>& buff, bool append_only)
 : data(&buff)
+, allocator()
 , id(0)
 , type(type)
+, dirty_ranges()
 , prev_size(0)
 , prev_capacity(data->capacity())
 , dirty(buff.size() != 0)
 , no_async(!append_only) {
+	if(!buff.empty()) allocator.append(buff.size());
 	gl.GenBuffers(1, &id);
 	gl.BindBuffer(type, id);
 	if(prev_capacity) gl.BufferData(type, prev_capacity, nullptr, GL_STREAM_DRAW);
 }
 
+size_t StreamingBuffer::alloc(size_t len){
+	const size_t off = allocator.alloc(len);
+	if(allocator.size() > data->size()){
+		data->resize(allocator.size());
+	}
+	return off;
+}
+
+size_t StreamingBuffer::append(size_t len){
+	const size_t off = allocator.append(len);
+	data->resize(allocator.size());
+	return off;
+}
+
+bool StreamingBuffer::extend(const BufferRange& range, size_t new_len){
+	if(!allocator.extend(range, new_len)) return false;
+	data->resize(allocator.size());
+	return true;
+}
+
+void StreamingBuffer::free(const BufferRange& range){
+	allocator.free(range);
+	if(allocator.size() < data->size()){
+		data->resize(allocator.size());
+	}
+	// anything appended over the freed tail has to be uploaded again.
+	prev_size = std::min(prev_size, data->size());
+}
+
+void StreamingBuffer::clear(){
+	allocator.clear();
+	data->clear();
+	dirty_ranges.clear();
+	prev_size = 0;
+	dirty = true;
+}
+
 void StreamingBuffer::mark(){
 	dirty = true;
 }
 
-void StreamingBuffer::invalidate(BufferRange&& range){
-	unused_bytes += range.len;
-	unused_ranges.push_back(std::move(range));
+void StreamingBuffer::mark(size_t off, size_t len){
+	if(len == 0) return;
+
+	// sequential writes are common enough to be worth joining here already.
+	if(!dirty_ranges.empty()){
+		BufferRange& r = dirty_ranges.back();
+		if(off >= r.off && off <= r.off + r.len){
+			r.len = std::max(r.len, off + len - r.off);
+			dirty = true;
+			return;
+		}
+	}
+
+	dirty_ranges.push_back(BufferRange{ off, len });
+	dirty = true;
 }
 
 void StreamingBuffer::invalidateAll(){
-	prev_size = 0;
-	dirty = true;
+	dirty_ranges.clear();
+	mark(0, data->size());
 }
 
 void StreamingBuffer::update(RenderState& rs){
@@ -87,14 +252,30 @@ void StreamingBuffer::update(RenderState& rs){
 		*rs_buffer = id;
 	}
 
-	bool done = false;
+	const size_t size = data->size();
+	const bool realloc = prev_capacity != data->capacity();
+
+	// everything past what the GPU already has, plus anything rewritten in place.
+	if(realloc){
+		dirty_ranges.clear();
+		if(size) dirty_ranges.push_back(BufferRange{ 0, size });
+	} else {
+		if(size > prev_size) dirty_ranges.push_back(BufferRange{ prev_size, size - prev_size });
+		coalesce_ranges(dirty_ranges, size);
+	}
+
+	const bool whole = dirty_ranges.size() == 1
+	                && dirty_ranges[0].off == 0
+	                && dirty_ranges[0].len == size;
+
+	bool done = dirty_ranges.empty() && !realloc;
 	
 	if(gl.streaming_mode->get() == DOUBLE_BUFFER){
 		log(logging::error, "gl_streaming_mode DOUBLE_BUFFER NYI");
 		gl.streaming_mode->set(BUFFER_INVALIDATE);
 	}
 	
-	if(gl.streaming_mode->get() == MAP_INVALIDATE && !no_async){
+	if(!done && gl.streaming_mode->get() == MAP_INVALIDATE && !no_async){
 		
 		if(!gl.MapBufferRange || !gl.UnmapBuffer){
 			log(logging::warn, "glMapBufferRange unavailable, using BUFFER_DATA_NULL.");
@@ -102,81 +283,81 @@ void StreamingBuffer::update(RenderState& rs){
 		} else {
 			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
 
-			if(prev_capacity != data->capacity()){
+			if(realloc){
 				gl.BufferData(type, data->capacity(), nullptr, GL_STREAM_DRAW);
 			} else {
 				flags |= GL_MAP_INVALIDATE_BUFFER_BIT;
 			}
 
-			tidy_buffer(*data, unused_ranges, unused_bytes);
-			
-			void* gl_data = gl.MapBufferRange(
-				type, 
-				0, 
-				data->size(),
-				flags
-			);
-			
-			memcpy(gl_data, data->data(), data->size());
-			
-			gl.UnmapBuffer(type);
+			// invalidating the whole buffer means all of it has to be written again.
+			if(size){
+				void* gl_data = gl.MapBufferRange(type, 0, size, flags);
+				memcpy(gl_data, data->data(), size);
+				gl.UnmapBuffer(type);
+			}
+			rs.stats.bytes_uploaded += size;
+			rs.stats.buffer_uploads++;
+			done = true;
 		}
 	}
 	
-	if(gl.streaming_mode->get() == MAP_UNSYNC_APPEND && !no_async){
+	if(!done && gl.streaming_mode->get() == MAP_UNSYNC_APPEND && !no_async){
 
 		if(!gl.MapBufferRange || !gl.UnmapBuffer){
 			log(logging::warn, "glMapBufferRange unavailable, using BUFFER_DATA_NULL.");
 			gl.streaming_mode->set(BUFFER_DATA_NULL);
 		} else {
-			if(prev_capacity != data->capacity()
-			|| unused_bytes/3 >= data->capacity()/4){
-				tidy_buffer(*data, unused_ranges, unused_bytes);
+			if(realloc){
 				gl.BufferData(type, data->capacity(), nullptr, GL_STREAM_DRAW);
-				prev_size = 0;
 			}
-		
-			void* gl_data = gl.MapBufferRange(
-				type,
-				prev_size,
-				data->size() - prev_size,
-				GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT
-			);
-			
-			memcpy(gl_data, data->data() + prev_size, data->size() - prev_size);
-			
-			gl.UnmapBuffer(type);
-		}
-	}
-	
-	if(gl.streaming_mode->get() == BUFFER_INVALIDATE || (no_async && !done)){
-	
-		if(gl.InvalidateBufferData){
-			gl.InvalidateBufferData(id);	
-			tidy_buffer(*data, unused_ranges, unused_bytes);
 
-			if(prev_capacity != data->capacity()){
-				gl.BufferData(type, data->capacity(), data->data(), GL_STREAM_DRAW);
-			} else {
-				gl.BufferSubData(type, 0, data->size(), data->data());
+			for(auto& r : dirty_ranges){
+				GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+
+				// only appends are safe to write without syncing, the GPU may still
+				// be reading from anything below prev_size.
+				if(realloc || r.off >= prev_size){
+					flags |= GL_MAP_UNSYNCHRONIZED_BIT;
+				}
+
+				void* gl_data = gl.MapBufferRange(type, r.off, r.len, flags);
+				memcpy(gl_data, data->data() + r.off, r.len);
+				gl.UnmapBuffer(type);
+
+				rs.stats.bytes_uploaded += r.len;
+				rs.stats.buffer_uploads++;
 			}
 			done = true;
+		}
+	}
+	
+	if(!done && (gl.streaming_mode->get() == BUFFER_INVALIDATE || no_async)){
+		if(realloc){
+			gl.BufferData(type, data->capacity(), nullptr, GL_STREAM_DRAW);
+		} else if(whole && gl.InvalidateBufferData){
+			gl.InvalidateBufferData(id);
+		}
 
-		} else if(!no_async) {
-			log(logging::warn, "glInvalidateBufferData unavailable, using BUFFER_DATA_NULL.");
-			gl.streaming_mode->set(BUFFER_DATA_NULL);
+		for(auto& r : dirty_ranges){
+			gl.BufferSubData(type, r.off, r.len, data->data() + r.off);
+			rs.stats.bytes_uploaded += r.len;
+			rs.stats.buffer_uploads++;
 		}
+		done = true;
 	}
 	
-	if(gl.streaming_mode->get() == BUFFER_DATA_NULL || (no_async && !done)){
-		tidy_buffer(*data, unused_ranges, unused_bytes);
+	if(!done){
 		gl.BufferData(type, data->capacity(), nullptr, GL_STREAM_DRAW);
-		gl.BufferSubData(type, 0, data->size(), data->data());
+		if(size) gl.BufferSubData(type, 0, size, data->data());
+		rs.stats.bytes_uploaded += size;
+		rs.stats.buffer_uploads++;
 		done = true;
 	}
+
 	dirty = false;
+	dirty_ranges.clear();
 	prev_capacity = data->capacity();
-	prev_size = data->size();
+	prev_size = size;
 }
 
 void StreamingBuffer::onGLContextRecreate(){
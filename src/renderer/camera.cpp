@@ -0,0 +1,138 @@
+#include "camera.h"
+#define GLM_FORCE_RADIANS
+#include <glm/gtc/matrix_transform.hpp>
+
+Camera::Camera()
+: proj()
+, view()
+, view_proj()
+, planes()
+, position(0.0f, 0.0f, 0.0f)
+, forward(0.0f, 0.0f, -1.0f)
+, up(0.0f, 1.0f, 0.0f)
+, aspect(1.0f)
+, z_near(1.0f)
+, z_far(1000.0f)
+, fov(90)
+, version(0)
+, ortho(true)
+, dirty(true) {
+
+}
+
+void Camera::setOrtho(glm::vec2 size){
+	proj = glm::ortho(0.f, size.x, size.y, 0.f);
+	ortho = true;
+	dirty = true;
+}
+
+void Camera::setPerspective(int fov, float aspect, float n, float f){
+	this->aspect = aspect;
+	z_near = n;
+	z_far = f;
+	ortho = false;
+	setFoV(fov);
+}
+
+void Camera::setFoV(int f){
+	fov = f;
+	if(ortho) return;
+
+	// same horizontal-fov frustum the renderer uses for u_perspective.
+	const float x_dist = tan((fov / 360.f) * M_PI) * z_near;
+	const float y_dist = x_dist / aspect;
+
+	proj = glm::frustum(-x_dist, x_dist, -y_dist, y_dist, z_near, z_far);
+	dirty = true;
+}
+
+void Camera::setPosition(glm::vec3 pos){
+	position = pos;
+	dirty = true;
+}
+
+void Camera::move(glm::vec3 delta){
+	position += delta;
+	dirty = true;
+}
+
+void Camera::lookAt(glm::vec3 target, glm::vec3 u){
+	forward = glm::normalize(target - position);
+	up = u;
+	dirty = true;
+}
+
+const glm::mat4& Camera::getMatrix(){
+	update();
+	return view_proj;
+}
+
+const glm::mat4& Camera::getViewMatrix(){
+	update();
+	return view;
+}
+
+bool Camera::isPointVisible(glm::vec3 p){
+	return isSphereVisible(p, 0.0f);
+}
+
+bool Camera::isSphereVisible(glm::vec3 c, float r){
+	update();
+
+	for(auto& pl : planes){
+		if(pl.x * c.x + pl.y * c.y + pl.z * c.z + pl.w < -r){
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Camera::isBoxVisible(glm::vec3 min, glm::vec3 max){
+	update();
+
+	for(auto& pl : planes){
+		// the corner furthest along the plane's normal is enough to reject the box.
+		glm::vec3 p(
+			pl.x > 0 ? max.x : min.x,
+			pl.y > 0 ? max.y : min.y,
+			pl.z > 0 ? max.z : min.z
+		);
+
+		if(pl.x * p.x + pl.y * p.y + pl.z * p.z + pl.w < 0){
+			return false;
+		}
+	}
+	return true;
+}
+
+void Camera::update(){
+	if(!dirty) return;
+
+	if(ortho){
+		view = glm::translate(glm::mat4(), -position);
+	} else {
+		view = glm::lookAt(position, position + forward, up);
+	}
+
+	view_proj = proj * view;
+
+	// Gribb-Hartmann plane extraction: left, right, bottom, top, near, far.
+	const glm::mat4& m = view_proj;
+	for(int i = 0; i < 6; ++i){
+		const int row = i / 2;
+		const float sign = (i % 2) ? -1.0f : 1.0f;
+
+		glm::vec4 pl(
+			m[0][3] + sign * m[0][row],
+			m[1][3] + sign * m[1][row],
+			m[2][3] + sign * m[2][row],
+			m[3][3] + sign * m[3][row]
+		);
+
+		const float len = sqrtf(pl.x * pl.x + pl.y * pl.y + pl.z * pl.z);
+		planes[i] = len > 0.0f ? pl / len : pl;
+	}
+
+	++version;
+	dirty = false;
+}
@@ -0,0 +1,112 @@
+#include "framebuffer.h"
+
+Framebuffer::Framebuffer(GLenum color_fmt, bool depth)
+: id(0)
+, depth_id(0)
+, color()
+, w(0)
+, h(0)
+, color_fmt(color_fmt)
+, status(0)
+, has_depth(depth) {
+
+}
+
+bool Framebuffer::isSupported(){
+	return gl.GenFramebuffers
+	    && gl.CheckFramebufferStatus
+	    && gl.GenRenderbuffers
+	    && gl.BlitFramebuffer;
+}
+
+bool Framebuffer::resize(int new_w, int new_h){
+	if(color.isValid() && new_w == w && new_h == h) return false;
+
+	w = new_w;
+	h = new_h;
+	status = 0;
+
+	color = Texture2D(GL_UNSIGNED_BYTE, color_fmt, w, h, nullptr);
+
+	if(has_depth){
+		if(!depth_id) gl.GenRenderbuffers(1, &depth_id);
+		gl.BindRenderbuffer(GL_RENDERBUFFER, depth_id);
+		gl.RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+		gl.BindRenderbuffer(GL_RENDERBUFFER, 0);
+	}
+
+	return true;
+}
+
+bool Framebuffer::bind(){
+	if(!color.isValid()) return false;
+	if(status && status != GL_FRAMEBUFFER_COMPLETE) return false;
+
+	if(!id){
+		gl.GenFramebuffers(1, &id);
+		status = 0;
+	}
+
+	gl.BindFramebuffer(GL_FRAMEBUFFER, id);
+
+	// attachments changed since this context last saw them.
+	if(!status){
+		gl.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color.getID(), 0);
+		if(has_depth){
+			gl.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_id);
+		}
+
+		if((status = gl.CheckFramebufferStatus(GL_FRAMEBUFFER)) != GL_FRAMEBUFFER_COMPLETE){
+			log(logging::error, "Framebuffer %dx%d incomplete (%#x).", w, h, status);
+			gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Framebuffer::bindDefault(){
+	gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer::blitToDefault(int dst_w, int dst_h, GLenum filter) const {
+	blitToDefault(w, h, dst_w, dst_h, filter);
+}
+
+void Framebuffer::blitToDefault(int src_w, int src_h, int dst_w, int dst_h, GLenum filter) const {
+	if(!id) return;
+
+	gl.BindFramebuffer(GL_READ_FRAMEBUFFER, id);
+	gl.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	gl.BlitFramebuffer(0, 0, src_w, src_h, 0, 0, dst_w, dst_h, GL_COLOR_BUFFER_BIT, filter);
+	gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer::deleteFramebuffer(){
+	if(id) gl.DeleteFramebuffers(1, &id);
+	id = 0;
+	status = 0;
+}
+
+void Framebuffer::clear(){
+	deleteFramebuffer();
+	if(depth_id) gl.DeleteRenderbuffers(1, &depth_id);
+	depth_id = 0;
+	color = Texture2D();
+	w = h = 0;
+}
+
+void Framebuffer::onGLContextRecreate(){
+	// the texture zeroes its own id, the next resize() makes everything again.
+	id = depth_id = 0;
+	w = h = 0;
+	status = 0;
+}
+
+Framebuffer::~Framebuffer(){
+	if(gl.initialized()){
+		if(id) gl.DeleteFramebuffers(1, &id);
+		if(depth_id) gl.DeleteRenderbuffers(1, &depth_id);
+	}
+}
@@ -1,5 +1,6 @@
 #include "gl_context.h"
 #include "engine.h"
+#include "renderer.h"
 #include "config.h"
 #include "enums.h"
 #include "util.h"
@@ -149,6 +150,9 @@ namespace {
 GLContext::GLContext()
 : version(0)
 , streaming_mode(nullptr)
+, program_cache(nullptr)
+, res(nullptr)
+, renderer(nullptr)
 #define GLFUNC(type, name, ...) \
 	, name(0)
 #include "gl_functions.h"
@@ -164,6 +168,12 @@ bool GLContext::createContext(Engine& e, SDL_Window* w){
 	if(!streaming_mode){
 		streaming_mode = e.cfg->addVar<CVarEnum>("gl_streaming_mode", gl_streaming_enum, 0);
 	}
+
+	if(!program_cache){
+		program_cache = e.cfg->addVar<CVarBool>("gl_program_cache", true);
+	}
+
+	res = e.res.get();
 	
 	int maj = 0, min = 0;
 	SDL_GL_GetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, &maj);
@@ -206,6 +216,24 @@ bool GLContext::createContext(Engine& e, SDL_Window* w){
 	}
 }
 
+SDL_GLContext GLContext::createSharedContext(SDL_Window* w){
+	if(!sdl_context) return nullptr;
+
+	SDL_GL_MakeCurrent(w, sdl_context);
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+	SDL_GLContext ctx = SDL_GL_CreateContext(w);
+	SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+
+	if(!ctx){
+		log(logging::warn, "Couldn't create shared OpenGL context (%s).", SDL_GetError());
+	}
+
+	// creating it made it current, but this thread keeps the main one.
+	SDL_GL_MakeCurrent(w, sdl_context);
+
+	return ctx;
+}
+
 void GLContext::deleteContext(void){
 	if(sdl_context){
 		SDL_GL_DeleteContext(sdl_context);
@@ -259,6 +287,10 @@ void GLContext::unregisterObject(GLObject& obj){
 	}
 }
 
+void GLContext::waitForFrame(){
+	if(renderer) renderer->waitForFrame();
+}
+
 bool GLContext::loadAllFuncs(void){
 	GetError    = (decltype(GetError))   SDL_GL_GetProcAddress("glGetError");
 	GetString   = (decltype(GetString))  SDL_GL_GetProcAddress("glGetString");
@@ -0,0 +1,141 @@
+#include "gpu_timer.h"
+#include <cstring>
+
+namespace {
+
+static const float smoothing = 0.9f;
+
+static bool same_label(const char* a, const char* b){
+	return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+}
+
+const int GpuTimer::num_frames;
+
+GpuTimer::GpuTimer()
+: frames()
+, current(0)
+, results()
+, frame_ms(0.0f) {
+
+}
+
+bool GpuTimer::isSupported(){
+	if(!gl.GenQueries || !gl.BeginQuery || !gl.QueryCounter || !gl.GetQueryObjectui64v){
+		return false;
+	}
+
+	GLint bits = 0;
+	gl.GetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+	if(bits == 0) return false;
+
+	const char* renderer = reinterpret_cast<const char*>(gl.GetString(GL_RENDERER));
+	if(!renderer) return false;
+
+	for(const char* sw : { "llvmpipe", "softpipe", "Software", "SwiftShader" }){
+		if(strstr(renderer, sw)){
+			log(logging::info, "GPU timers disabled on software renderer '%s'.", renderer);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void GpuTimer::beginFrame(){
+	current = (current + 1) % num_frames;
+	Frame& f = frames[current];
+
+	if(f.pending) collect(f);
+
+	if(!f.elapsed) gl.GenQueries(1, &f.elapsed);
+	gl.BeginQuery(GL_TIME_ELAPSED, f.elapsed);
+
+	f.used = 0;
+}
+
+void GpuTimer::mark(const char* label){
+	Frame& f = frames[current];
+
+	if(f.used == f.stamps.size()){
+		GLuint q = 0;
+		gl.GenQueries(1, &q);
+		f.stamps.push_back(q);
+		f.labels.push_back(nullptr);
+	}
+
+	gl.QueryCounter(f.stamps[f.used], GL_TIMESTAMP);
+	f.labels[f.used] = label;
+	f.used++;
+}
+
+void GpuTimer::endFrame(){
+	// closes off the last group.
+	mark(nullptr);
+	gl.EndQuery(GL_TIME_ELAPSED);
+	frames[current].pending = true;
+}
+
+void GpuTimer::collect(Frame& f){
+	f.pending = false;
+
+	GLint ready = 0;
+	gl.GetQueryObjectiv(f.elapsed, GL_QUERY_RESULT_AVAILABLE, &ready);
+	if(ready && f.used){
+		gl.GetQueryObjectiv(f.stamps[f.used - 1], GL_QUERY_RESULT_AVAILABLE, &ready);
+	}
+	if(!ready){
+		TRACEF("GPU timer results not ready, dropping frame.");
+		return;
+	}
+
+	GLuint64 elapsed = 0;
+	gl.GetQueryObjectui64v(f.elapsed, GL_QUERY_RESULT, &elapsed);
+	frame_ms = frame_ms * smoothing + (elapsed / 1e6f) * (1.0f - smoothing);
+
+	for(auto& r : results){
+		r.ms *= smoothing;
+	}
+
+	GLuint64 prev = 0;
+	for(size_t i = 0; i < f.used; ++i){
+		GLuint64 t = 0;
+		gl.GetQueryObjectui64v(f.stamps[i], GL_QUERY_RESULT, &t);
+
+		if(i > 0){
+			addResult(f.labels[i - 1], ((t - prev) / 1e6f) * (1.0f - smoothing));
+		}
+		prev = t;
+	}
+}
+
+void GpuTimer::addResult(const char* label, float ms){
+	for(auto& r : results){
+		if(same_label(r.label, label)){
+			r.ms += ms;
+			return;
+		}
+	}
+	results.push_back(Result{ label, ms });
+}
+
+void GpuTimer::clear(){
+	for(auto& f : frames){
+		if(!f.stamps.empty()) gl.DeleteQueries(f.stamps.size(), f.stamps.data());
+		if(f.elapsed) gl.DeleteQueries(1, &f.elapsed);
+		f = Frame();
+	}
+}
+
+void GpuTimer::onGLContextRecreate(){
+	for(auto& f : frames){
+		f = Frame();
+	}
+	results.clear();
+	frame_ms = 0.0f;
+}
+
+GpuTimer::~GpuTimer(){
+	if(gl.initialized()) clear();
+}
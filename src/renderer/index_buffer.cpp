@@ -1,4 +1,6 @@
 #include "index_buffer.h"
+#include <algorithm>
+#include <vector>
 
 StaticIndexBuffer::StaticIndexBuffer()
 : data()
@@ -39,6 +41,91 @@ void StaticIndexBuffer::onGLContextRecreate(){
 }
 
 StaticIndexBuffer::~StaticIndexBuffer(){
+	gl.waitForFrame();
 	gl.DeleteBuffers(1, &id);
 }
 
+
+const size_t QuadIndexBuffer::max_quads;
+
+std::shared_ptr<QuadIndexBuffer> QuadIndexBuffer::get(){
+	static std::weak_ptr<QuadIndexBuffer> shared;
+
+	auto ptr = shared.lock();
+	if(!ptr){
+		ptr = std::make_shared<QuadIndexBuffer>();
+		shared = ptr;
+	}
+	return ptr;
+}
+
+QuadIndexBuffer::QuadIndexBuffer()
+: quads(0)
+, needed(0)
+, id(0) {
+	gl.GenBuffers(1, &id);
+}
+
+void QuadIndexBuffer::reserve(size_t n){
+	n = std::min(n, max_quads);
+
+	size_t prev = needed;
+	while(prev < n && !needed.compare_exchange_weak(prev, n));
+}
+
+void QuadIndexBuffer::bind(RenderState& rs){
+	if(rs.ibo != id){
+		gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, id);
+		rs.ibo = id;
+	}
+}
+
+GLenum QuadIndexBuffer::getType() const {
+	return GL_UNSIGNED_SHORT;
+}
+
+GLuint QuadIndexBuffer::getID() const {
+	return id;
+}
+
+void QuadIndexBuffer::update(RenderState& rs){
+	if(needed <= quads) return;
+
+	quads = std::min(std::max<size_t>(needed, quads * 2), max_quads);
+
+	// always rebind, a VAO bound since the last bind() would otherwise miss it.
+	gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, id);
+	rs.ibo = id;
+	upload();
+}
+
+void QuadIndexBuffer::upload(){
+	std::vector<uint16_t> indices;
+	indices.reserve(quads * 6);
+
+	for(size_t q = 0; q < quads; ++q){
+		for(auto i : { 0, 1, 2, 2, 1, 3 }){
+			indices.push_back(q * 4 + i);
+		}
+	}
+
+	gl.BufferData(
+		GL_ELEMENT_ARRAY_BUFFER,
+		indices.size() * sizeof(uint16_t),
+		indices.data(),
+		GL_STATIC_DRAW
+	);
+}
+
+void QuadIndexBuffer::onGLContextRecreate(){
+	gl.GenBuffers(1, &id);
+	gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, id);
+	if(quads) upload();
+}
+
+QuadIndexBuffer::~QuadIndexBuffer(){
+	gl.waitForFrame();
+	if(id && gl.initialized()){
+		gl.DeleteBuffers(1, &id);
+	}
+}
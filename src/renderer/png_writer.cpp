@@ -0,0 +1,99 @@
+#include "png_writer.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+static std::array<uint32_t, 256> make_crc_table(){
+	std::array<uint32_t, 256> table;
+	for(uint32_t i = 0; i < 256; ++i){
+		uint32_t c = i;
+		for(int k = 0; k < 8; ++k){
+			c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+		}
+		table[i] = c;
+	}
+	return table;
+}
+
+static uint32_t png_crc(const uint8_t* data, size_t len, uint32_t crc = 0xFFFFFFFF){
+	static const std::array<uint32_t, 256> table = make_crc_table();
+
+	for(size_t i = 0; i < len; ++i){
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+static void put_be32(std::vector<uint8_t>& out, uint32_t v){
+	out.push_back(v >> 24);
+	out.push_back(v >> 16);
+	out.push_back(v >> 8);
+	out.push_back(v);
+}
+
+static void put_chunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data){
+	put_be32(out, data.size());
+
+	const size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+
+	put_be32(out, png_crc(out.data() + start, out.size() - start) ^ 0xFFFFFFFF);
+}
+
+}
+
+void png_encode(const uint8_t* rgba, int w, int h, std::vector<uint8_t>& out){
+	static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	out.assign(signature, signature + sizeof(signature));
+
+	std::vector<uint8_t> ihdr;
+	put_be32(ihdr, w);
+	put_be32(ihdr, h);
+	ihdr.insert(ihdr.end(), {
+		8, // bit depth
+		6, // RGBA
+		0, // deflate
+		0, // adaptive filtering
+		0  // no interlacing
+	});
+	put_chunk(out, "IHDR", ihdr);
+
+	// each row is prefixed with its filter type, 0 for none.
+	const size_t row_sz = size_t(w) * 4;
+	std::vector<uint8_t> raw((row_sz + 1) * h);
+	for(int y = 0; y < h; ++y){
+		raw[y * (row_sz + 1)] = 0;
+		memcpy(&raw[y * (row_sz + 1) + 1], rgba + y * row_sz, row_sz);
+	}
+
+	std::vector<uint8_t> idat = { 0x78, 0x01 };
+	uint32_t a = 1, b = 0;
+
+	for(size_t off = 0;; /**/){
+		const size_t len = std::min<size_t>(raw.size() - off, 0xFFFF);
+		const bool last = off + len == raw.size();
+
+		idat.push_back(last ? 1 : 0);
+		idat.push_back(len);
+		idat.push_back(len >> 8);
+		idat.push_back(~len);
+		idat.push_back(~len >> 8);
+		idat.insert(idat.end(), raw.begin() + off, raw.begin() + off + len);
+
+		for(size_t i = off; i < off + len; ++i){
+			a = (a + raw[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+
+		if(last) break;
+		off += len;
+	}
+	put_be32(idat, (b << 16) | a);
+
+	put_chunk(out, "IDAT", idat);
+	put_chunk(out, "IEND", {});
+}
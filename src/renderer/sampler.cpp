@@ -44,6 +44,7 @@ void Sampler::onGLContextRecreate(){
 }
 
 Sampler::~Sampler(){
+	gl.waitForFrame();
 	if(gl.DeleteSamplers && id){
 		gl.DeleteSamplers(1, &id);
 	}
@@ -2,6 +2,9 @@
 #include "gl_context.h"
 #include "vertex_state.h"
 #include "render_state.h"
+#include "resource_system.h"
+#include "uniform_buffer.h"
+#include "config.h"
 #include <algorithm>
 
 using namespace std;
@@ -14,12 +17,55 @@ static const char* shader_name(GLenum type){
 	}
 }
 
+namespace {
+
+// program binaries on disk are this header followed by the driver's blob.
+struct ProgramCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vs_hash, fs_hash, driver_hash;
+	uint32_t format;
+};
+
+static const uint32_t program_cache_magic   = 0x47525045; // "EPRG"
+static const uint32_t program_cache_version = 1;
+
+static size_t program_cache_hits = 0, program_cache_misses = 0;
+
+static uint32_t driver_hash(){
+	uint32_t hash = 6159;
+	for(GLenum e : { GL_VENDOR, GL_RENDERER, GL_VERSION }){
+		if(const char* s = reinterpret_cast<const char*>(gl.GetString(e))){
+			hash = hash * 187 + str_hash(s);
+		}
+	}
+	return hash;
+}
+
+static bool program_cache_enabled(){
+	if(!gl.res || !gl.program_cache || !gl.program_cache->val) return false;
+	if(!gl.GetProgramBinary || !gl.ProgramBinary) return false;
+
+	GLint num_formats = 0;
+	gl.GetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+	return num_formats > 0;
+}
+
+}
+
 ShaderBase::ShaderBase(GLenum type, MemBlock mem)
 : type(type)
-, id(gl.CreateShader(type)){
+, id(0)
+, src(mem.ptr, mem.ptr + mem.size)
+, hash(str_hash_len(src.data(), src.size())) {
 
-	const GLchar* str = reinterpret_cast<const GLchar*>(mem.ptr);
-	GLint str_sz = mem.size;
+}
+
+void ShaderBase::compile() const {
+	id = gl.CreateShader(type);
+
+	const GLchar* str = src.data();
+	GLint str_sz = src.size();
 
 	const char** str_ptr = &str;
 	const GLint* str_sz_ptr = &str_sz;
@@ -27,7 +73,7 @@ ShaderBase::ShaderBase(GLenum type, MemBlock mem)
 
 #ifdef __EMSCRIPTEN__
 	const char webgl_precision[] = "precision mediump float;\n";
-	const char* webgl_str = strchr(str, '\n') + 1;
+	const char* webgl_str = reinterpret_cast<const char*>(memchr(str, '\n', str_sz)) + 1;
 	const char* webgl_lines[2] = { webgl_precision, webgl_str };
 	const GLint webgl_sizes[2] = { sizeof(webgl_precision) - 1, str_sz - (webgl_str - str) };
 
@@ -56,9 +102,15 @@ ShaderBase::ShaderBase(GLenum type, MemBlock mem)
 }
 
 GLuint ShaderBase::getID(void) const {
+	if(!id) compile();
 	return id;
 }
 
+void ShaderBase::onGLContextRecreate(){
+	// compiled again on demand.
+	id = 0;
+}
+
 ShaderBase::~ShaderBase(){
 	if(gl.initialized() && id){
 		TRACEF("Deleting shader %d.", id);
@@ -71,19 +123,38 @@ ShaderProgram::ShaderProgram(Proxy<VertShader> v, Proxy<FragShader> f)
 , fs(f)
 , program_id(0)
 , uniforms()
-, attribs() {
+, attribs()
+, uses_globals(false) {
 
 }
 
 bool ShaderProgram::link(void){
 	if(program_id) return true;
 	
+	const bool use_cache = program_cache_enabled();
+	const uint32_t key = use_cache ? (vs->getHash() * 187 + fs->getHash()) * 187 + driver_hash() : 0;
+
 	program_id = gl.CreateProgram();
-	
-	gl.AttachShader(program_id, vs->getID());
-	gl.AttachShader(program_id, fs->getID());
 
-	gl.LinkProgram(program_id);
+	const bool loaded_from_cache = use_cache && loadBinary(key);
+
+	if(loaded_from_cache){
+		++program_cache_hits;
+		log(logging::info, "Program cache hit [%08x] (%zu hits, %zu misses).",
+			key, program_cache_hits, program_cache_misses);
+	} else {
+		if(use_cache){
+			++program_cache_misses;
+			log(logging::info, "Program cache miss [%08x] (%zu hits, %zu misses).",
+				key, program_cache_hits, program_cache_misses);
+			gl.ProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
+		gl.AttachShader(program_id, vs->getID());
+		gl.AttachShader(program_id, fs->getID());
+
+		gl.LinkProgram(program_id);
+	}
 	
 	GLint linked_ok = GL_FALSE;
 	gl.GetProgramiv(program_id, GL_LINK_STATUS, &linked_ok);
@@ -100,6 +171,19 @@ bool ShaderProgram::link(void){
 		
 		return false;
 	}
+
+	if(use_cache && !loaded_from_cache){
+		saveBinary(key);
+	}
+
+	uses_globals = false;
+	if(UniformBuffer::isSupported()){
+		GLuint block = gl.GetUniformBlockIndex(program_id, GlobalUniforms::block_name);
+		if(block != GL_INVALID_INDEX){
+			gl.UniformBlockBinding(program_id, block, GlobalUniforms::binding);
+			uses_globals = true;
+		}
+	}
 	
 	GLint amount = 0;
 	char name_buf[256];
@@ -116,6 +200,9 @@ bool ShaderProgram::link(void){
 		if(!*n || (n[0] == 'g' && n[1] == 'l' && n[2] == '_')) continue;
 		
 		GLint index = gl.GetUniformLocation(program_id, name_buf);
+
+		// members of uniform blocks have no location.
+		if(index < 0) continue;
 		
 		uniforms.initUniform(name_buf, program_id, index, size, type);
 	}
@@ -140,6 +227,59 @@ bool ShaderProgram::link(void){
 	return true;
 }
 
+bool ShaderProgram::loadBinary(uint32_t key){
+	char name[64] = {};
+	snprintf(name, sizeof(name), "shadercache/%08x.bin", key);
+
+	ResourceHandle rh = gl.res->loadUserFile(name);
+	if(!rh || rh.size() <= sizeof(ProgramCacheHeader)) return false;
+
+	ProgramCacheHeader hdr = {};
+	memcpy(&hdr, rh.data(), sizeof(hdr));
+
+	if(hdr.magic       != program_cache_magic
+	|| hdr.version     != program_cache_version
+	|| hdr.vs_hash     != vs->getHash()
+	|| hdr.fs_hash     != fs->getHash()
+	|| hdr.driver_hash != driver_hash()){
+		return false;
+	}
+
+	gl.ProgramBinary(program_id, hdr.format, rh.data() + sizeof(hdr), rh.size() - sizeof(hdr));
+
+	// the driver is free to reject old binaries, e.g. after an update.
+	GLint linked_ok = GL_FALSE;
+	gl.GetProgramiv(program_id, GL_LINK_STATUS, &linked_ok);
+
+	if(!linked_ok){
+		log(logging::info, "Cached program binary %s was rejected.", name);
+		gl.DeleteProgram(program_id);
+		program_id = gl.CreateProgram();
+	}
+
+	return linked_ok;
+}
+
+void ShaderProgram::saveBinary(uint32_t key){
+	GLint len = 0;
+	gl.GetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &len);
+	if(len <= 0) return;
+
+	ProgramCacheHeader hdr = {
+		program_cache_magic, program_cache_version,
+		vs->getHash(), fs->getHash(), driver_hash(), 0
+	};
+
+	std::vector<uint8_t> blob(sizeof(hdr) + len);
+	gl.GetProgramBinary(program_id, len, &len, &hdr.format, blob.data() + sizeof(hdr));
+	memcpy(blob.data(), &hdr, sizeof(hdr));
+
+	char name[64] = {};
+	snprintf(name, sizeof(name), "shadercache/%08x.bin", key);
+
+	gl.res->saveUserFile(name, MemBlock(blob.data(), sizeof(hdr) + len));
+}
+
 bool ShaderProgram::bind(RenderState& render_state){
 	if(program_id != render_state.program){
 		gl.UseProgram(program_id);
@@ -153,7 +293,7 @@ void ShaderProgram::setUniforms(const ShaderUniforms& su){
 }
 
 void ShaderProgram::setAttribs(RenderState& rs, VertexState& vstate){
-	vstate.setAttribArrays(rs, attribs);
+	vstate.setAttribArrays(rs, program_id, attribs);
 }
 
 void ShaderProgram::onGLContextRecreate(){
@@ -169,6 +309,7 @@ void ShaderProgram::onGLContextRecreate(){
 }
 
 ShaderProgram::~ShaderProgram(){
+	gl.waitForFrame();
 	if(program_id && gl.initialized()){
 		gl.DeleteProgram(program_id);
 	}
@@ -23,6 +23,12 @@ void ShaderAttribs::setAttribFormat(uint32_t hash, GLenum type, int nelem, int o
 	}
 }
 
+bool ShaderAttribs::isInstanced() const {
+	return std::any_of(attribs.begin(), attribs.end(), [](const Attrib& a){
+		return a.flags & ATR_INSTANCED;
+	});
+}
+
 bool ShaderAttribs::containsAttrib(uint32_t hash, GLint index) const {
 	auto it = std::find(attribs.begin(), attribs.end(), hash);
 	if(it == attribs.end() || (index != -1 && it->index != index)){
@@ -39,6 +45,11 @@ bool ShaderAttribs::bind(uint32_t hash, GLuint index, GLuint stride) const {
 
 	const void* off = reinterpret_cast<void*>(it->off);
 
+	// with vertex_attrib_binding the divisor is per-buffer instead, see VertexState.
+	if(!gl.VertexAttribFormat && gl.VertexAttribDivisor){
+		gl.VertexAttribDivisor(index, (it->flags & ATR_INSTANCED) ? 1 : 0);
+	}
+
 	if(it->flags & ATR_INT){
 		if(gl.VertexAttribIFormat){
 			gl.VertexAttribIFormat(index, it->nelem, it->type, it->off);
@@ -1,6 +1,7 @@
 #include "shader_uniforms.h"
 #include <algorithm>
 #include <tuple>
+#include <atomic>
 
 namespace {
 using namespace std;
@@ -77,14 +78,88 @@ tuple<GLenum, uint32_t, uint32_t> get_full_type_info(GLenum type){
 	}
 }
 
+// serials identify a ShaderUniforms in the plans, since addresses get reused.
+static std::atomic<uint32_t> next_serial(1);
+
+void upload_uniform(GLint idx, GLenum type, uint32_t rows, uint32_t cols, uint32_t count, const void* ptr){
+	if(type == GL_INT){
+		assert(rows == 1);
+		const GLint* ip = reinterpret_cast<const GLint*>(ptr);
+		switch(cols){
+			case 1: gl.Uniform1iv(idx, count, ip); break;
+			case 2: gl.Uniform2iv(idx, count, ip); break;
+			case 3: gl.Uniform3iv(idx, count, ip); break;
+			case 4: gl.Uniform4iv(idx, count, ip); break;
+		}
+	} else 
+	if(type == GL_UNSIGNED_INT){
+		assert(rows == 1);
+		const GLuint* up = reinterpret_cast<const GLuint*>(ptr);
+		switch(cols){
+			case 1: gl.Uniform1uiv(idx, count, up); break;
+			case 2: gl.Uniform2uiv(idx, count, up); break;
+			case 3: gl.Uniform3uiv(idx, count, up); break;
+			case 4: gl.Uniform4uiv(idx, count, up); break;
+		}
+	} else {
+		assert(type == GL_FLOAT);
+		const GLfloat* fp = reinterpret_cast<const GLfloat*>(ptr);
+		     if(rows == 1 && cols == 1) gl.Uniform1fv(idx, count, fp);
+		else if(rows == 1 && cols == 2) gl.Uniform2fv(idx, count, fp);
+		else if(rows == 1 && cols == 3) gl.Uniform3fv(idx, count, fp);
+		else if(rows == 1 && cols == 4) gl.Uniform4fv(idx, count, fp);
+		else if(rows == 2 && cols == 2) gl.UniformMatrix2fv(idx, count, GL_FALSE, fp);
+		else if(rows == 3 && cols == 3) gl.UniformMatrix3fv(idx, count, GL_FALSE, fp);
+		else if(rows == 4 && cols == 4) gl.UniformMatrix4fv(idx, count, GL_FALSE, fp);
+		else if(rows == 2 && cols == 3) gl.UniformMatrix2x3fv(idx, count, GL_FALSE, fp);
+		else if(rows == 3 && cols == 2) gl.UniformMatrix3x2fv(idx, count, GL_FALSE, fp);
+		else if(rows == 2 && cols == 4) gl.UniformMatrix2x4fv(idx, count, GL_FALSE, fp);
+		else if(rows == 4 && cols == 2) gl.UniformMatrix4x2fv(idx, count, GL_FALSE, fp);
+		else if(rows == 3 && cols == 4) gl.UniformMatrix3x4fv(idx, count, GL_FALSE, fp);
+		else if(rows == 4 && cols == 3) gl.UniformMatrix4x3fv(idx, count, GL_FALSE, fp);		
+	}
 }
 
+}
+
+const size_t ShaderUniforms::max_plans;
+
 ShaderUniforms::ShaderUniforms()
 : uniforms()
-, uniform_info() {
+, uniform_info()
+, plans()
+, serial(next_serial++)
+, layout(0) {
+
+}
+
+// copies get their own serial, so they are never mistaken for the original.
+ShaderUniforms::ShaderUniforms(const ShaderUniforms& other)
+: uniforms(other.uniforms)
+, uniform_info(other.uniform_info)
+, plans()
+, serial(next_serial++)
+, layout(0) {
 
 }
 
+ShaderUniforms& ShaderUniforms::operator=(const ShaderUniforms& other){
+	uniforms = other.uniforms;
+	uniform_info = other.uniform_info;
+	plans.clear();
+	serial = next_serial++;
+	layout = 0;
+	return *this;
+}
+
+void ShaderUniforms::snapshot(const ShaderUniforms& other){
+	uniforms = other.uniforms;
+	uniform_info = other.uniform_info;
+	plans.clear();
+	serial = other.serial;
+	layout = other.layout;
+}
+
 bool ShaderUniforms::operator==(const ShaderUniforms& other) const {
 	bool result = true;
 	
@@ -116,13 +191,13 @@ bool ShaderUniforms::operator==(const ShaderUniforms& other) const {
 	return result;
 }
 
-bool ShaderUniforms::bind(GLuint program_id, ShaderUniforms& active) const {
-	const ustorage* p = uniforms.data();
-	
-	TRACEF("ucount: %zd, active ucount: %zd.", uniform_info.size(), active.uniform_info.size());
-	
-	for(auto& i : uniform_info){
-		
+void ShaderUniforms::buildPlan(Plan& plan, const ShaderUniforms& active) const {
+	plan.layout = layout;
+	plan.entries.clear();
+
+	for(size_t n = 0; n < uniform_info.size(); ++n){
+		const uinfo& i = uniform_info[n];
+
 		auto ai = std::find(active.uniform_info.begin(), active.uniform_info.end(), i.name_hash);
 		if(ai == active.uniform_info.end()){
 			TRACEF("Uniform %#x not available in actives.", i.name_hash);
@@ -132,56 +207,50 @@ bool ShaderUniforms::bind(GLuint program_id, ShaderUniforms& active) const {
 			i.type, ai->type, i.rows, ai->rows, i.cols, ai->cols, i.count, ai->count);
 			continue;
 		}
-				
-		const size_t sz = i.rows * i.cols * i.count * 4;
-			
-		if(memcmp(p + i.storage_index, active.uniforms.data() + ai->storage_index, sz) == 0){
-			TRACEF("Skip uniform %d, already set.", ai->idx);
-			continue;
+
+		assert(ai->idx >= 0);
+
+		plan.entries.push_back({
+			ai->idx, i.rows, i.cols, i.count, i.type, i.storage_index,
+			n, size_t(ai - active.uniform_info.begin())
+		});
+	}
+}
+
+bool ShaderUniforms::bind(GLuint program_id, ShaderUniforms& active) const {
+	auto plan = std::find_if(active.plans.begin(), active.plans.end(), [&](const Plan& p){
+		return p.serial == serial;
+	});
+
+	if(plan == active.plans.end()){
+		if(active.plans.size() >= max_plans){
+			active.plans.erase(active.plans.begin());
 		}
-		
-		TRACEF("Updating uniform %d...", ai->idx);
-		memcpy(active.uniforms.data() + ai->storage_index, p + i.storage_index, sz);
-		
-		const GLint idx = ai->idx;
-		assert(idx >= 0);
-		
-		if(i.type == GL_INT){
-			assert(i.rows == 1);
-			const GLint* ip = reinterpret_cast<const GLint*>(p+i.storage_index);
-			switch(i.cols){
-				case 1: gl.Uniform1iv(idx, i.count, ip); break;
-				case 2: gl.Uniform2iv(idx, i.count, ip); break;
-				case 3: gl.Uniform3iv(idx, i.count, ip); break;
-				case 4: gl.Uniform4iv(idx, i.count, ip); break;
-			}
-		} else 
-		if(i.type == GL_UNSIGNED_INT){
-			assert(i.rows == 1);
-			const GLuint* up = reinterpret_cast<const GLuint*>(p+i.storage_index);
-			switch(i.cols){
-				case 1: gl.Uniform1uiv(idx, i.count, up); break;
-				case 2: gl.Uniform2uiv(idx, i.count, up); break;
-				case 3: gl.Uniform3uiv(idx, i.count, up); break;
-				case 4: gl.Uniform4uiv(idx, i.count, up); break;
-			}
-		} else {
-			assert(i.type == GL_FLOAT);
-			const GLfloat* fp = reinterpret_cast<const GLfloat*>(p+i.storage_index);
-			     if(i.rows == 1 && i.cols == 1) gl.Uniform1fv(idx, i.count, fp);
-			else if(i.rows == 1 && i.cols == 2) gl.Uniform2fv(idx, i.count, fp);
-			else if(i.rows == 1 && i.cols == 3) gl.Uniform3fv(idx, i.count, fp);
-			else if(i.rows == 1 && i.cols == 4) gl.Uniform4fv(idx, i.count, fp);
-			else if(i.rows == 2 && i.cols == 2) gl.UniformMatrix2fv(idx, i.count, GL_FALSE, fp);
-			else if(i.rows == 3 && i.cols == 3) gl.UniformMatrix3fv(idx, i.count, GL_FALSE, fp);
-			else if(i.rows == 4 && i.cols == 4) gl.UniformMatrix4fv(idx, i.count, GL_FALSE, fp);
-			else if(i.rows == 2 && i.cols == 3) gl.UniformMatrix2x3fv(idx, i.count, GL_FALSE, fp);
-			else if(i.rows == 3 && i.cols == 2) gl.UniformMatrix3x2fv(idx, i.count, GL_FALSE, fp);
-			else if(i.rows == 2 && i.cols == 4) gl.UniformMatrix2x4fv(idx, i.count, GL_FALSE, fp);
-			else if(i.rows == 4 && i.cols == 2) gl.UniformMatrix4x2fv(idx, i.count, GL_FALSE, fp);
-			else if(i.rows == 3 && i.cols == 4) gl.UniformMatrix3x4fv(idx, i.count, GL_FALSE, fp);
-			else if(i.rows == 4 && i.cols == 3) gl.UniformMatrix4x3fv(idx, i.count, GL_FALSE, fp);		
+		active.plans.push_back({ serial, layout - 1, {} });
+		plan = active.plans.end() - 1;
+	}
+
+	if(plan->layout != layout){
+		TRACEF("Building uniform plan for %u.", serial);
+		buildPlan(*plan, active);
+	}
+
+	const ustorage* p = uniforms.data();
+
+	for(auto& e : plan->entries){
+		const uint32_t version = uniform_info[e.src_index].version;
+		uinfo& ai = active.uniform_info[e.active_index];
+
+		if(ai.bound_serial == serial && ai.version == version){
+			TRACEF("Skip uniform %d, already set.", e.loc);
+			continue;
 		}
+
+		TRACEF("Updating uniform %d...", e.loc);
+		ai.bound_serial = serial;
+		ai.version = version;
+
+		upload_uniform(e.loc, e.type, e.rows, e.cols, e.count, p + e.storage_index);
 	}
 	return true;
 }
@@ -238,12 +307,15 @@ void ShaderUniforms::initUniform(const char* name, GLuint prog, GLint idx, GLuin
 		uniforms.push_back(buf[i]);
 	}
 	
-	uniform_info.push_back({ hash, rows, cols, 1, storage_idx, subtype, idx });
+	uniform_info.push_back({ hash, rows, cols, 1, storage_idx, subtype, idx, 0, 0 });
+	++layout;
 }
 
 void ShaderUniforms::clear(){
 	uniforms.clear();
 	uniform_info.clear();
+	plans.clear();
+	++layout;
 }
 
 void ShaderUniforms::_setUniform(uint32_t hash, uint32_t rows, uint32_t cols, uint32_t count, GLenum type, const void* ptr){
@@ -258,7 +330,8 @@ void ShaderUniforms::_setUniform(uint32_t hash, uint32_t rows, uint32_t cols, ui
 			uniforms.push_back(storage_ptr[i]);
 		}
 		
-		uniform_info.push_back({ hash, rows, cols, count, storage_idx, type, -1 });
+		uniform_info.push_back({ hash, rows, cols, count, storage_idx, type, -1, 1, 0 });
+		++layout;
 	} else {
 		assert(rows == it->rows);
 		assert(cols == it->cols);
@@ -268,6 +341,7 @@ void ShaderUniforms::_setUniform(uint32_t hash, uint32_t rows, uint32_t cols, ui
 		for(int i = 0; i < limit; ++i){
 			uniforms[it->storage_index + i] = storage_ptr[i];
 		}
+		++it->version;
 	}
 }
 
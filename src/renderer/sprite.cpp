@@ -1,11 +1,23 @@
 #include "sprite.h"
 #include "sprite_batch.h"
 
+Sprite::Sprite()
+: batch(nullptr)
+, slot(0)
+, position()
+, size()
+, tex_frame()
+, region(nullptr) {
+
+}
+
 Sprite::Sprite(SpriteBatch& b, glm::ivec2 pos, glm::ivec2 sz, glm::ivec2 frame)
 : batch(&b)
+, slot(0)
 , position(pos)
 , size(sz)
-, tex_frame(frame) {
+, tex_frame(frame)
+, region(nullptr) {
 	if(batch){
 		batch->addSprite(*this);
 	}
@@ -13,9 +25,11 @@ Sprite::Sprite(SpriteBatch& b, glm::ivec2 pos, glm::ivec2 sz, glm::ivec2 frame)
 
 Sprite::Sprite(std::tuple<SpriteBatch&, glm::ivec2&&, glm::ivec2&&>&& t)
 : batch(&std::get<0>(t))
+, slot(0)
 , position(std::get<1>(t))
 , size(std::get<2>(t))
-, tex_frame({ 0, 0 }){
+, tex_frame({ 0, 0 })
+, region(nullptr) {
 	if(batch){
 		batch->addSprite(*this);
 	}
@@ -23,11 +37,14 @@ Sprite::Sprite(std::tuple<SpriteBatch&, glm::ivec2&&, glm::ivec2&&>&& t)
 
 Sprite::Sprite(Sprite&& other)
 : batch(other.batch)
+, slot(0)
 , position(other.position)
 , size(other.size)
-, tex_frame(other.tex_frame){
+, tex_frame(other.tex_frame)
+, region(other.region) {
 	if(batch){
-		batch->addSprite(*this);
+		batch->moveSprite(other, *this);
+		other.batch = nullptr;
 	}
 }
 
@@ -52,6 +69,13 @@ void Sprite::setFrame(glm::ivec2 frame){
 	}
 }
 
+void Sprite::setRegion(const AtlasRegion* r){
+	region = r;
+	if(batch){
+		batch->updateSprite(*this);
+	}
+}
+
 Sprite::~Sprite(){
 	if(batch){
 		batch->delSprite(*this);
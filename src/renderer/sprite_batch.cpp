@@ -2,115 +2,307 @@
 #include "sprite.h"
 #include "material.h"
 #include "renderer.h"
+#include "camera.h"
+#include "texture_atlas.h"
+#include <climits>
 
+namespace {
+
+// layer is the AtlasRegion's page, only read by shaders sampling an array TextureAtlas.
 struct Vert {
 	Vert() = default;
-	Vert(int16_t x, int16_t y, uint16_t tx, uint16_t ty)
-		: x(x), y(y), tx(tx), ty(ty){}
+	Vert(int16_t x, int16_t y, uint16_t tx, uint16_t ty, uint16_t layer)
+		: x(x), y(y), tx(tx), ty(ty), layer(layer), pad(0){}
 	int16_t x, y;
 	uint16_t tx, ty;
+	uint16_t layer, pad;
 };
 
+VERTEX_LAYOUT(vert_layout, Vert,
+	VATTR(Vert, x    , "a_pos"  , 2),
+	VATTR(Vert, tx   , "a_tex"  , 2, ATR_NORM),
+	VATTR(Vert, layer, "a_layer", 1)
+);
+
+struct SpriteInstance {
+	SpriteInstance() = default;
+	SpriteInstance(glm::ivec2 pos, glm::ivec2 size, const uint16_t (&tex)[4], uint16_t layer)
+		: x(pos.x), y(pos.y), w(size.x), h(size.y), tx0(tex[0]), ty0(tex[1]), tx1(tex[2]), ty1(tex[3])
+		, layer(layer), pad(0){}
+	int16_t x, y, w, h;
+	uint16_t tx0, ty0, tx1, ty1;
+	uint16_t layer, pad;
+};
+
+static_assert(sizeof(SpriteInstance) == 20, "SpriteInstance should be 20 bytes");
+
+VERTEX_LAYOUT(instance_layout, SpriteInstance,
+	VATTR(SpriteInstance, x    , "a_pos"    , 2, ATR_INSTANCED),
+	VATTR(SpriteInstance, w    , "a_size"   , 2, ATR_INSTANCED),
+	VATTR(SpriteInstance, tx0  , "a_texrect", 4, ATR_NORM | ATR_INSTANCED),
+	VATTR(SpriteInstance, layer, "a_layer"  , 1, ATR_INSTANCED)
+);
+
+// corners of the quad every instance is drawn with, in the same order as the Verts.
+static const uint8_t quad_corners[4][4] = {
+	{ 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 }
+};
+
+static bool can_instance(){
+	return gl.DrawElementsInstanced
+	    && (gl.VertexAttribFormat ? gl.VertexBindingDivisor : gl.VertexAttribDivisor);
+}
+
+}
+
+const size_t SpriteBatch::page_size;
+
+SpriteBatch::SpriteBatch()
+: slots()
+, dirty_slots()
+, pages()
+, instanced(false)
+, vertex_layout(vert_layout)
+, corners()
+, indices()
+, material(nullptr)
+, camera(nullptr)
+, renderable()
+, tex_cells(1, 1) {
+
+}
+
 SpriteBatch::SpriteBatch(Material& m, glm::ivec2 tex_cells)
-: vertices("a_pos:2s|a_tex:2SN", 512)
+: SpriteBatch(m, nullptr, tex_cells) {
+
+}
+
+SpriteBatch::SpriteBatch(Material& m, ShaderProgram& inst_shader, glm::ivec2 tex_cells)
+: SpriteBatch(m, &inst_shader, tex_cells) {
+
+}
+
+SpriteBatch::SpriteBatch(Material& m, ShaderProgram* inst_shader, glm::ivec2 tex_cells)
+: slots()
+, dirty_slots()
+, pages()
+, instanced(inst_shader && can_instance())
+, vertex_layout(instanced ? instance_layout : vert_layout)
+, corners()
+, indices(QuadIndexBuffer::get())
 , material(&m)
-, renderable(&vao, m.shader, &m.uniforms, RType{ GL_TRIANGLES })
+, camera(nullptr)
+, renderable(instanced ? inst_shader : m.shader, &m.uniforms, RType{ GL_TRIANGLES })
 , tex_cells(tex_cells) {
 	assert(tex_cells.x > 0 && tex_cells.y > 0);
 
-	vao.setVertexBuffers({ &vertices });
-	vao.setIndexBuffer(&indices);
+	if(instanced){
+		corners.reset(new StaticVertexBuffer(quad_corners, "a_corner:2B"));
+		indices->reserve(1);
+	}
 
 	renderable.textures[0] = m.texture;
 	renderable.samplers[0] = m.sampler;
 }
 
-void SpriteBatch::addSprite(const Sprite& s){
-	sprites[&s].dirty = true;
+SpriteBatch::Page::Page(const VertexLayout& layout, const Renderable& r)
+: vao()
+, vertices(layout, 512)
+, renderable(r)
+, lo()
+, hi()
+, bounds_dirty(false) {
+	renderable.vertex_state = &vao;
+	resetBounds();
+}
+
+void SpriteBatch::Page::resetBounds(){
+	lo = glm::ivec2(INT_MAX, INT_MAX);
+	hi = glm::ivec2(INT_MIN, INT_MIN);
+}
+
+bool SpriteBatch::Page::onEdge(const Slot& s) const {
+	if(s.lo.x > s.hi.x) return false;
+	return s.lo.x <= lo.x || s.lo.y <= lo.y || s.hi.x >= hi.x || s.hi.y >= hi.y;
+}
+
+SpriteBatch::Page& SpriteBatch::addPage(){
+	pages.emplace_back(new Page(vertex_layout, renderable));
+	Page& p = *pages.back();
+
+	if(instanced){
+		p.vao.setVertexBuffers({ corners.get(), &p.vertices });
+	} else {
+		p.vao.setVertexBuffers({ &p.vertices });
+	}
+	p.vao.setIndexBuffer(indices.get());
+
+	return p;
+}
+
+void SpriteBatch::addSprite(Sprite& s){
+	const uint32_t slot = slots.size();
+
+	// an empty box, so it's never on its page's edge before it's first written.
+	slots.push_back(Slot{ &s, glm::ivec2(INT_MAX), glm::ivec2(INT_MIN), false });
+	s.slot = slot;
+
+	// pages are only ever added, so an emptied page is reused instead of recreated.
+	Page& page = (slot / page_size < pages.size())
+		? *pages[slot / page_size]
+		: addPage();
+
+	// slots are dense, so this always comes off the end of the page's buffer.
+	const size_t per_slot = instanced ? 1 : 4;
+	const size_t v_off = page.vertices.alloc(per_slot);
+	assert(v_off == (slot % page_size) * per_slot);
+
+	markSlot(slot);
+}
+
+void SpriteBatch::delSprite(Sprite& s){
+	const uint32_t slot = s.slot, last = slots.size() - 1;
+	assert(slot < slots.size() && slots[slot].sprite == &s);
+
+	// the removed box, and the moved one if it changes page, may have been holding
+	// their page's bounds out, so those pages get rebuilt without them.
+	Page& page = *pages[last / page_size];
+
+	if(pages[slot / page_size]->onEdge(slots[slot])){
+		pages[slot / page_size]->bounds_dirty = true;
+	}
+	if(page.onEdge(slots[last])){
+		page.bounds_dirty = true;
+	}
+
+	// swap-remove: the last sprite takes over the freed slot and rewrites its verts there.
+	if(slot != last){
+		slots[slot].sprite = slots[last].sprite;
+		slots[slot].sprite->slot = slot;
+		slots[slot].lo = slots[last].lo;
+		slots[slot].hi = slots[last].hi;
+		markSlot(slot);
+	}
+
+	slots.pop_back();
+
+	const size_t per_slot = instanced ? 1 : 4;
+	page.vertices.free((last % page_size) * per_slot, per_slot);
+
+	if(last % page_size == 0){
+		page.resetBounds();
+	}
 }
 
-void SpriteBatch::delSprite(const Sprite& s){
-	sprites.erase(&s);
+void SpriteBatch::moveSprite(Sprite& from, Sprite& to){
+	assert(from.slot < slots.size() && slots[from.slot].sprite == &from);
+
+	to.slot = from.slot;
+	slots[to.slot].sprite = &to;
 }
 
 void SpriteBatch::updateSprite(const Sprite& s){
-	auto it = sprites.find(&s);
-	if(it != sprites.end()){
-		it->second.dirty = true;
+	if(s.slot < slots.size() && slots[s.slot].sprite == &s){
+		markSlot(s.slot);
+	}
+}
+
+void SpriteBatch::markSlot(uint32_t slot){
+	if(!slots[slot].dirty){
+		slots[slot].dirty = true;
+		dirty_slots.push_back(slot);
 	}
 }
 
 void SpriteBatch::draw(Renderer& r){
-	for(auto& pair : sprites){
-		if(!pair.second.dirty) continue;
-
-		auto pos   = pair.first->getPosition();
-		auto sz    = pair.first->getSize() / 2;
-		auto frame = pair.first->getFrame();
-
-		glm::vec4 tex_coords = {
-			frame.x       / (float) tex_cells.x,
-			frame.y       / (float) tex_cells.y,
-			(frame.x + 1) / (float) tex_cells.x,
-			(frame.y + 1) / (float) tex_cells.y
-		};
-
-		uint16_t tx0 = tex_coords.x * USHRT_MAX,
-				 ty0 = tex_coords.y * USHRT_MAX,
-				 tx1 = tex_coords.z * USHRT_MAX,
-				 ty1 = tex_coords.w * USHRT_MAX;
-
-		if(pair.second.v_off > 0){
-			vertices.invalidate(BufferRange{
-				(pair.second.v_off - 1) * sizeof(Vert),
-				4 * sizeof(Vert),
-				this
-			});
+	draw(r.getCommandList());
+}
+
+void SpriteBatch::draw(CommandList& cl){
+	for(uint32_t slot : dirty_slots){
+		// entries for slots freed since they were marked are skipped.
+		if(slot >= slots.size() || !slots[slot].dirty) continue;
+
+		const Sprite* s = slots[slot].sprite;
+
+		auto pos   = s->getPosition();
+		auto sz    = s->getSize() / 2;
+		auto frame = s->getFrame();
+
+		uint16_t tex[4], layer = 0;
+
+		if(const AtlasRegion* region = s->getRegion()){
+			std::copy(region->tex, region->tex + 4, tex);
+			layer = region->page;
+		} else {
+			tex[0] = (frame.x       / (float) tex_cells.x) * USHRT_MAX;
+			tex[1] = (frame.y       / (float) tex_cells.y) * USHRT_MAX;
+			tex[2] = ((frame.x + 1) / (float) tex_cells.x) * USHRT_MAX;
+			tex[3] = ((frame.y + 1) / (float) tex_cells.y) * USHRT_MAX;
 		}
-		
-		const size_t v_sz  = vertices.getSize(),
-		             i_sz  = indices.getSize(),
-		             i_off = pair.second.i_off;
-
-		size_t index = i_off - 1;	
-		for(auto i : { 0, 1, 2, 2, 1, 3 }){
-			if(i_off > 0){
-				indices.replace(index++, v_sz + i);
-			} else {
-				indices.push(v_sz + i);
-			}
+
+		Page& page = *pages[slot / page_size];
+		DynamicVertexBuffer& vertices = page.vertices;
+		const size_t local = slot % page_size;
+
+		// growing is cheap, but moving in from the edge means the page has to be rebuilt.
+		Slot& sl = slots[slot];
+		if(page.onEdge(sl)){
+			page.bounds_dirty = true;
 		}
 
-		if(i_off == 0){
-			pair.second.i_off = i_sz + 1;
+		sl.lo = pos - sz;
+		sl.hi = pos + sz;
+		page.lo = glm::min(page.lo, sl.lo);
+		page.hi = glm::max(page.hi, sl.hi);
+
+		if(instanced){
+			vertices.replace(local, SpriteInstance(pos, s->getSize(), tex, layer));
+		} else {
+			BufferSpan<Vert> v = vertices.write<Vert>(local * 4, 4);
+
+			v[0] = Vert(pos.x - sz.x, pos.y - sz.y, tex[0], tex[1], layer);
+			v[1] = Vert(pos.x - sz.x, pos.y + sz.y, tex[0], tex[3], layer);
+			v[2] = Vert(pos.x + sz.x, pos.y - sz.y, tex[2], tex[1], layer);
+			v[3] = Vert(pos.x + sz.x, pos.y + sz.y, tex[2], tex[3], layer);
 		}
-		pair.second.v_off = v_sz + 1;
 
-		vertices.push(Vert(pos.x - sz.x, pos.y - sz.y, tx0, ty0));
-		vertices.push(Vert(pos.x - sz.x, pos.y + sz.y, tx0, ty1));
-		vertices.push(Vert(pos.x + sz.x, pos.y - sz.y, tx1, ty0));
-		vertices.push(Vert(pos.x + sz.x, pos.y + sz.y, tx1, ty1));
+		slots[slot].dirty = false;
+	}
+	dirty_slots.clear();
 
-		pair.second.dirty = false;
+	if(!instanced){
+		indices->reserve(std::min(slots.size(), page_size));
 	}
-	renderable.count = indices.getSize();
 
-	r.addRenderable(renderable);
-}
+	for(size_t i = 0; i < pages.size(); ++i){
+		const size_t first = i * page_size;
+		if(first >= slots.size()) break;
 
-void SpriteBatch::onBufferRangeInvalidated(size_t off, size_t len){
-	for(auto& pair : sprites){
-		size_t& v_off = pair.second.v_off;
-		size_t& i_off = pair.second.i_off;
-		if((v_off - 1) * sizeof(Vert) <= off) continue;
-		
-		v_off -= (len / sizeof(Vert));
+		const size_t count = std::min(slots.size() - first, page_size);
+		Page& page = *pages[i];
+		Renderable& pr = page.renderable;
 
-		assert(i_off > 0);
+		if(page.bounds_dirty){
+			page.resetBounds();
+			for(size_t j = first; j < first + count; ++j){
+				page.lo = glm::min(page.lo, slots[j].lo);
+				page.hi = glm::max(page.hi, slots[j].hi);
+			}
+			page.bounds_dirty = false;
+		}
+
+		if(camera && !camera->isBoxVisible(glm::vec3(page.lo, 0), glm::vec3(page.hi, 0))){
+			continue;
+		}
 
-		size_t index = i_off - 1;
-		for(auto i : { 0, 1, 2, 2, 1, 3 }){
-			indices.replace(index++, (v_off - 1) + i);
+		if(instanced){
+			pr.count = 6;
+			pr.instances = count;
+		} else {
+			pr.count = count * 6;
 		}
+
+		cl.addRenderable(pr);
 	}
 }
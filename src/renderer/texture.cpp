@@ -1,8 +1,12 @@
 #include "texture.h"
 #include "resource_system.h"
 #include "render_state.h"
+#include "texture_loader.h"
+#include "renderer.h"
+#include "engine.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
+#include <algorithm>
 
 namespace {
 
@@ -121,15 +125,21 @@ static GLenum get_base_fmt(GLenum sized_fmt){
 	}
 }
 
-void texture2d_init(GLuint& id, GLenum type, GLenum int_fmt, int w, int h, const void* data){
+void texture2d_init(GLuint& id, GLenum type, GLenum int_fmt, int w, int h, const void* data, int levels = 1){
 
 	gl.GenTextures(1, &id);
 	gl.BindTexture(GL_TEXTURE_2D, id);
 	if(gl.TexStorage2D){
-		gl.TexStorage2D(GL_TEXTURE_2D, 1, int_fmt, w, h);
-		gl.TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, get_base_fmt(int_fmt), type, data);
+		gl.TexStorage2D(GL_TEXTURE_2D, levels, int_fmt, w, h);
+		if(data){
+			gl.TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, get_base_fmt(int_fmt), type, data);
+		}
 	} else {
-		gl.TexImage2D(GL_TEXTURE_2D, 0, get_base_fmt(int_fmt), w, h, 0, get_base_fmt(int_fmt), type, data);
+		for(int i = 0; i < levels; ++i){
+			const int lw = std::max(1, w >> i), lh = std::max(1, h >> i);
+			gl.TexImage2D(GL_TEXTURE_2D, i, get_base_fmt(int_fmt), lw, lh, 0, get_base_fmt(int_fmt), type, i ? nullptr : data);
+		}
+		gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
 		gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 		gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		gl.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -137,39 +147,167 @@ void texture2d_init(GLuint& id, GLenum type, GLenum int_fmt, int w, int h, const
 	}
 }
 
+// expects the texture to still be bound from texture2d_init.
+void texture2d_gen_mips(GLenum type, GLenum int_fmt, int w, int h, const void* data, int levels){
+	if(gl.GenerateMipmap){
+		gl.GenerateMipmap(GL_TEXTURE_2D);
+	} else if(type == GL_UNSIGNED_BYTE && int_fmt == GL_RGBA8){
+		MipChain mips(reinterpret_cast<const uint8_t*>(data), w, h);
+		for(int i = 1; i < levels; ++i){
+			const int lw = std::max(1, w >> i), lh = std::max(1, h >> i);
+			gl.TexSubImage2D(GL_TEXTURE_2D, i, 0, 0, lw, lh, GL_RGBA, type, mips.getLevel(i));
+		}
+	} else {
+		log(logging::warn, "Can't generate mipmaps for format %#x without glGenerateMipmap.", int_fmt);
+	}
+}
+
+void texture2d_load(GLuint& id, int& w, int& h, MemBlock img){
+	uint8_t* pixels = stbi_load_from_memory(img.ptr, img.size, &w, &h, nullptr, 4);
+	
+	texture2d_init(id, GL_UNSIGNED_BYTE, GL_RGBA8, w, h, pixels);
+	
+	stbi_image_free(pixels);
+}
+
 }
 
 using namespace std;
 
+MipChain::MipChain()
+: data()
+, w(0)
+, h(0)
+, levels(1) {
+
+}
+
+MipChain::MipChain(const uint8_t* pixels, int w, int h)
+: data(levelOffset(w, h, numLevels(w, h)) - w * h * 4)
+, w(w)
+, h(h)
+, levels(numLevels(w, h)) {
+
+	const uint8_t* src = pixels;
+	uint8_t* dst = data.data();
+	int pw = w, ph = h;
+
+	for(int i = 1; i < levels; ++i){
+		const int lw = std::max(1, pw / 2), lh = std::max(1, ph / 2);
+
+		for(int y = 0; y < lh; ++y){
+			const int y0 = std::min(y * 2, ph - 1), y1 = std::min(y * 2 + 1, ph - 1);
+
+			for(int x = 0; x < lw; ++x){
+				const int x0 = std::min(x * 2, pw - 1), x1 = std::min(x * 2 + 1, pw - 1);
+
+				for(int c = 0; c < 4; ++c){
+					const int sum = src[(y0 * pw + x0) * 4 + c] + src[(y0 * pw + x1) * 4 + c]
+					              + src[(y1 * pw + x0) * 4 + c] + src[(y1 * pw + x1) * 4 + c];
+					dst[(y * lw + x) * 4 + c] = (sum + 2) / 4;
+				}
+			}
+		}
+
+		src = dst;
+		dst += lw * lh * 4;
+		pw = lw;
+		ph = lh;
+	}
+}
+
+int MipChain::numLevels(int w, int h){
+	int n = 1;
+	for(int sz = std::max(w, h); sz > 1; sz /= 2) ++n;
+	return n;
+}
+
+size_t MipChain::levelOffset(int w, int h, int level){
+	size_t off = 0;
+	for(int i = 0; i < level; ++i){
+		off += size_t(std::max(1, w >> i)) * std::max(1, h >> i) * 4;
+	}
+	return off;
+}
+
+const uint8_t* MipChain::getLevel(int level) const {
+	assert(level >= 1 && level < levels);
+	return data.data() + levelOffset(w, h, level) - w * h * 4;
+}
+
 Texture2D::Texture2D()
 : id(0)
 , w(0)
-, h(0) {
+, h(0)
+, levels(1)
+, loader(nullptr) {
 
 }
 
 Texture2D::Texture2D(MemBlock img)
 : id(0)
 , w(0)
-, h(0) {
-	uint8_t* pixels = stbi_load_from_memory(img.ptr, img.size, &w, &h, nullptr, 4);
-	
-	texture2d_init(id, GL_UNSIGNED_BYTE, GL_RGBA8, w, h, pixels);
-	
-	stbi_image_free(pixels);
+, h(0)
+, levels(1)
+, loader(nullptr) {
+	texture2d_load(id, w, h, img);
+}
+
+Texture2D::Texture2D(Engine& e, MemBlock img)
+: id(0)
+, w(0)
+, h(0)
+, levels(1)
+, loader(nullptr) {
+	TextureLoader& tl = e.renderer->getTextureLoader();
+
+	TextureImage image;
+
+	if(tl.isAsync() && stbi_info_from_memory(img.ptr, img.size, &w, &h, nullptr)){
+		tl.load(*this, img);
+	} else if(tl.decode(img, image)){
+		w = image.w;
+		h = image.h;
+		levels = image.levels;
+		texture2d_init(id, GL_UNSIGNED_BYTE, GL_RGBA8, w, h, image.pixels, levels);
+
+		for(int i = 1; i < levels; ++i){
+			const int lw = std::max(1, w >> i), lh = std::max(1, h >> i);
+			gl.TexSubImage2D(GL_TEXTURE_2D, i, 0, 0, lw, lh, GL_RGBA, GL_UNSIGNED_BYTE, image.getLevel(i));
+		}
+	} else {
+		log(logging::error, "Couldn't decode texture data.");
+	}
 }
 
-Texture2D::Texture2D(GLenum type, GLenum int_fmt, int w, int h, const void* data)
+Texture2D::Texture2D(GLenum type, GLenum int_fmt, int w, int h, const void* data, int levels)
 : id(0)
 , w(w)
-, h(h) {
-	texture2d_init(id, type, int_fmt, w, h, data);
+, h(h)
+, levels(std::max(1, std::min(levels, MipChain::numLevels(w, h))))
+, loader(nullptr) {
+	texture2d_init(id, type, int_fmt, w, h, data, this->levels);
+
+	if(data && this->levels > 1){
+		texture2d_gen_mips(type, int_fmt, w, h, data, this->levels);
+	}
 }
 
+// the pending load (if any) stays with *this, see TextureLoader::update.
 Texture2D& Texture2D::operator=(Texture2D&& other){
 	std::swap(id, other.id);
 	std::swap(w, other.w);
 	std::swap(h, other.h);
+	std::swap(levels, other.levels);
+	std::swap(loader, other.loader);
+
+	// a pending load goes wherever the texture it was for went.
+	if(loader){
+		loader->swapTargets(*this, other);
+	}
+	if(other.loader && other.loader != loader){
+		other.loader->swapTargets(*this, other);
+	}
 	return *this;
 }
 
@@ -190,7 +328,15 @@ GLenum Texture2D::getType(void) const {
 }
 
 bool Texture2D::isValid(void) const {
-	return id != 0;
+	return id != 0 || loader;
+}
+
+bool Texture2D::isReady(void) const {
+	return !loader;
+}
+
+int Texture2D::getLevels(void) const {
+	return levels;
 }
 
 std::tuple<int, int> Texture2D::getSize() const {
@@ -198,6 +344,10 @@ std::tuple<int, int> Texture2D::getSize() const {
 }
 
 bool Texture2D::bind(size_t tex_unit, RenderState& rs) const {
+	if(!id && loader){
+		return loader->getPlaceholder().bind(tex_unit, rs);
+	}
+
 	if(id && id != rs.tex[tex_unit]){
 		if(rs.active_tex != tex_unit){
 			gl.ActiveTexture(GL_TEXTURE0 + tex_unit);
@@ -217,6 +367,145 @@ void Texture2D::onGLContextRecreate(){
 }
 
 Texture2D::~Texture2D(){
+	gl.waitForFrame();
+	if(loader) loader->cancel(*this);
 	if(id && gl.initialized()) gl.DeleteTextures(1, &id);
 }
 
+Texture2DArray::Texture2DArray()
+: id(0)
+, w(0)
+, h(0)
+, layers(0)
+, levels(1)
+, type(GL_UNSIGNED_BYTE)
+, int_fmt(GL_RGBA8) {
+
+}
+
+Texture2DArray::Texture2DArray(GLenum type, GLenum int_fmt, int w, int h, int layers, const void* data, int levels)
+: id(0)
+, w(w)
+, h(h)
+, layers(layers)
+, levels(std::max(1, std::min(levels, MipChain::numLevels(w, h))))
+, type(type)
+, int_fmt(int_fmt) {
+
+	if(!isSupported()){
+		log(logging::error, "Can't create Texture2DArray: not supported by OpenGL driver.");
+		return;
+	}
+
+	if(w <= 0 || h <= 0 || layers <= 0){
+		log(logging::error, "Can't create Texture2DArray with a size of %dx%dx%d.", w, h, layers);
+		return;
+	}
+
+	const GLenum base_fmt = get_base_fmt(int_fmt);
+
+	gl.GenTextures(1, &id);
+	gl.BindTexture(GL_TEXTURE_2D_ARRAY, id);
+
+	if(gl.TexStorage3D){
+		gl.TexStorage3D(GL_TEXTURE_2D_ARRAY, this->levels, int_fmt, w, h, layers);
+		if(data){
+			gl.TexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, w, h, layers, base_fmt, type, data);
+		}
+	} else {
+		for(int i = 0; i < this->levels; ++i){
+			const int lw = std::max(1, w >> i), lh = std::max(1, h >> i);
+			gl.TexImage3D(GL_TEXTURE_2D_ARRAY, i, base_fmt, lw, lh, layers, 0, base_fmt, type, i ? nullptr : data);
+		}
+		gl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, this->levels - 1);
+		gl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		gl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		gl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		gl.TexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	if(data && this->levels > 1){
+		generateMipmaps();
+	}
+}
+
+Texture2DArray& Texture2DArray::operator=(Texture2DArray&& other){
+	std::swap(id, other.id);
+	std::swap(w, other.w);
+	std::swap(h, other.h);
+	std::swap(layers, other.layers);
+	std::swap(levels, other.levels);
+	std::swap(type, other.type);
+	std::swap(int_fmt, other.int_fmt);
+	return *this;
+}
+
+bool Texture2DArray::isSupported(){
+	return gl.TexImage3D && (gl.version >= 30 || gl.hasExtension("EXT_texture_array"));
+}
+
+bool Texture2DArray::setLayer(int layer, const void* data){
+	if(!id || layer < 0 || layer >= layers) return false;
+
+	//XXX: binds directly, like texture creation does.
+	gl.BindTexture(GL_TEXTURE_2D_ARRAY, id);
+	gl.TexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, w, h, 1, get_base_fmt(int_fmt), type, data);
+	return true;
+}
+
+void Texture2DArray::generateMipmaps(){
+	if(!id || levels <= 1) return;
+
+	if(gl.GenerateMipmap){
+		gl.BindTexture(GL_TEXTURE_2D_ARRAY, id);
+		gl.GenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	} else {
+		log(logging::warn, "Can't generate Texture2DArray mipmaps without glGenerateMipmap.");
+	}
+}
+
+bool Texture2DArray::setSwizzle(const std::array<GLint, 4>& swizzle){
+	if(!(gl.version >= 33
+	|| gl.hasExtension("EXT_texture_swizzle") 
+	|| gl.hasExtension("ARB_texture_swizzle"))){
+		log(logging::error, "Can't set swizzle: not supported by OpenGL driver.");
+		return false;
+	}
+	//XXX: assume texture is already bound
+	gl.TexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, swizzle.data());
+	return true;
+}
+
+GLenum Texture2DArray::getType(void) const {
+	return GL_TEXTURE_2D_ARRAY;
+}
+
+bool Texture2DArray::isValid(void) const {
+	return id != 0;
+}
+
+std::tuple<int, int> Texture2DArray::getSize() const {
+	return std::make_tuple(w, h);
+}
+
+bool Texture2DArray::bind(size_t tex_unit, RenderState& rs) const {
+	if(id && id != rs.tex[tex_unit]){
+		if(rs.active_tex != tex_unit){
+			gl.ActiveTexture(GL_TEXTURE0 + tex_unit);
+			rs.active_tex = tex_unit;
+		}
+		gl.BindTexture(GL_TEXTURE_2D_ARRAY, id);
+		rs.tex[tex_unit] = id;
+	}
+	return true;
+}
+
+void Texture2DArray::onGLContextRecreate(){
+	// same as Texture2D, the owner is responsible for recreating it.
+	id = 0;
+}
+
+Texture2DArray::~Texture2DArray(){
+	gl.waitForFrame();
+	if(id && gl.initialized()) gl.DeleteTextures(1, &id);
+}
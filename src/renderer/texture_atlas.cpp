@@ -0,0 +1,229 @@
+#include "texture_atlas.h"
+#include "engine.h"
+#include "resource_system.h"
+#include "stb/stb_image.h"
+#include <algorithm>
+#include <climits>
+
+SkylinePacker::SkylinePacker(int w, int h)
+: skyline({ Node{ 0, 0, w } })
+, width(w)
+, height(h) {
+
+}
+
+int SkylinePacker::fit(size_t i, int w, int h) const {
+	if(skyline[i].x + w > width) return -1;
+
+	int y = skyline[i].y, remaining = w;
+
+	for(size_t j = i; remaining > 0; ++j){
+		y = std::max(y, skyline[j].y);
+		if(y + h > height) return -1;
+		remaining -= skyline[j].w;
+	}
+
+	return y;
+}
+
+bool SkylinePacker::pack(int w, int h, glm::ivec2& pos){
+	int best_y = INT_MAX, best_w = INT_MAX;
+	size_t best_i = skyline.size();
+
+	for(size_t i = 0; i < skyline.size(); ++i){
+		int y = fit(i, w, h);
+		if(y < 0) continue;
+
+		if(y + h < best_y || (y + h == best_y && skyline[i].w < best_w)){
+			best_y = y + h;
+			best_w = skyline[i].w;
+			best_i = i;
+		}
+	}
+
+	if(best_i == skyline.size()) return false;
+
+	pos = glm::ivec2(skyline[best_i].x, best_y - h);
+	skyline.insert(skyline.begin() + best_i, Node{ pos.x, best_y, w });
+
+	// trim the nodes now covered by the new one.
+	for(size_t i = best_i + 1; i < skyline.size(); /**/){
+		const Node& prev = skyline[i-1];
+		const int overlap = prev.x + prev.w - skyline[i].x;
+
+		if(overlap <= 0) break;
+
+		skyline[i].x += overlap;
+		skyline[i].w -= overlap;
+
+		if(skyline[i].w <= 0){
+			skyline.erase(skyline.begin() + i);
+		} else {
+			break;
+		}
+	}
+
+	for(size_t i = 0; i + 1 < skyline.size(); /**/){
+		if(skyline[i].y == skyline[i+1].y){
+			skyline[i].w += skyline[i+1].w;
+			skyline.erase(skyline.begin() + i + 1);
+		} else {
+			++i;
+		}
+	}
+
+	return true;
+}
+
+TextureAtlas::Page::Page(int size)
+: packer(size, size)
+, pixels(size * size * 4)
+, tex() {
+
+}
+
+TextureAtlas::TextureAtlas(Engine& e, std::initializer_list<const char*> images, int page_size, int padding, bool use_array)
+: pages()
+, regions()
+, array()
+, page_size(page_size)
+, use_array(use_array && Texture2DArray::isSupported()) {
+
+	struct Image {
+		const char* name;
+		uint8_t* pixels;
+		int w, h;
+	};
+
+	std::vector<Image> decoded;
+
+	for(auto* name : images){
+		Image img = { name, nullptr, 0, 0 };
+
+		if(ResourceHandle rh = e.res->load(name)){
+			img.pixels = stbi_load_from_memory(rh.data(), rh.size(), &img.w, &img.h, nullptr, 4);
+		}
+
+		if(!img.pixels){
+			log(logging::error, "TextureAtlas: couldn't load image '%s'.", name);
+		} else if(img.w + padding > page_size || img.h + padding > page_size){
+			log(logging::error, "TextureAtlas: '%s' doesn't fit in a %dpx page.", name, page_size);
+			stbi_image_free(img.pixels);
+		} else {
+			decoded.push_back(img);
+		}
+	}
+
+	// tallest first packs a skyline noticeably tighter.
+	std::sort(decoded.begin(), decoded.end(), [](const Image& a, const Image& b){
+		return a.h > b.h;
+	});
+
+	for(auto& img : decoded){
+		glm::ivec2 pos;
+		uint32_t p = 0;
+
+		while(p < pages.size() && !pages[p].packer.pack(img.w + padding, img.h + padding, pos)){
+			++p;
+		}
+
+		if(p == pages.size()){
+			pages.emplace_back(page_size);
+			pages.back().packer.pack(img.w + padding, img.h + padding, pos);
+		}
+
+		uint8_t* dst = pages[p].pixels.data();
+		for(int y = 0; y < img.h; ++y){
+			memcpy(dst + ((pos.y + y) * page_size + pos.x) * 4, img.pixels + (y * img.w * 4), img.w * 4);
+		}
+
+		const float scale = USHRT_MAX / (float) page_size;
+
+		AtlasRegion r = {
+			str_hash(img.name),
+			p,
+			glm::ivec4(pos.x, pos.y, img.w, img.h),
+			{
+				uint16_t(pos.x * scale),
+				uint16_t(pos.y * scale),
+				uint16_t((pos.x + img.w) * scale),
+				uint16_t((pos.y + img.h) * scale)
+			}
+		};
+		regions.push_back(r);
+
+		stbi_image_free(img.pixels);
+	}
+
+	createTextures();
+
+	log(logging::info, "TextureAtlas: packed %zu images into %zu page(s).", regions.size(), pages.size());
+}
+
+const AtlasRegion* TextureAtlas::getRegion(const char* name) const {
+	const uint32_t hash = str_hash(name);
+
+	for(auto& r : regions){
+		if(r.name_hash == hash) return &r;
+	}
+
+	return nullptr;
+}
+
+int TextureAtlas::addPage(const uint8_t* rgba, int w, int h){
+	if(w > page_size || h > page_size){
+		log(logging::error, "TextureAtlas: a %dx%d page doesn't fit in a %dpx page.", w, h, page_size);
+		return -1;
+	}
+
+	pages.emplace_back(page_size);
+	Page& page = pages.back();
+
+	// nothing else gets packed around it.
+	glm::ivec2 pos;
+	page.packer.pack(page_size, page_size, pos);
+
+	for(int y = 0; y < h; ++y){
+		memcpy(page.pixels.data() + (y * page_size * 4), rgba + (y * w * 4), w * 4);
+	}
+
+	// layers are fixed when an array texture is created, so the whole thing is remade.
+	createTextures();
+
+	return pages.size() - 1;
+}
+
+void TextureAtlas::createTextures(){
+	// assign into existing textures where possible, since materials point at them.
+	if(use_array){
+		// made even while empty, so the pointer is there for materials before addPage.
+		if(!array) array.reset(new Texture2DArray());
+		if(pages.empty()) return;
+
+		Texture2DArray tex(GL_UNSIGNED_BYTE, GL_RGBA8, page_size, page_size, pages.size(), nullptr);
+		for(size_t i = 0; i < pages.size(); ++i){
+			tex.setLayer(i, pages[i].pixels.data());
+		}
+
+		*array = std::move(tex);
+	} else {
+		for(auto& page : pages){
+			Texture2D tex(GL_UNSIGNED_BYTE, GL_RGBA8, page_size, page_size, page.pixels.data());
+
+			if(!page.tex) page.tex.reset(new Texture2D());
+			*page.tex = std::move(tex);
+		}
+	}
+}
+
+void TextureAtlas::onGLContextRecreate(){
+	// make sure the old ids are dropped first, so the swaps don't delete them.
+	if(array){
+		gl.validateObject(*array);
+	}
+	for(auto& page : pages){
+		if(page.tex) gl.validateObject(*page.tex);
+	}
+
+	createTextures();
+}
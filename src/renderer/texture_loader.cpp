@@ -0,0 +1,380 @@
+#include "texture_loader.h"
+#include "texture.h"
+#include "render_state.h"
+#include "job_system.h"
+#include "engine.h"
+#include "config.h"
+#include "stb/stb_image.h"
+#include <algorithm>
+
+namespace {
+
+// cache blobs are this header followed by the RGBA8 pixels of each level.
+struct TexCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t src_hash;
+	uint32_t src_size;
+	uint32_t format;
+	uint32_t width, height, levels;
+};
+
+static const uint32_t tex_cache_magic   = 0x58455445; // "ETEX"
+static const uint32_t tex_cache_version = 2;
+
+}
+
+const size_t TextureLoader::num_pbos;
+
+TextureImage::TextureImage()
+: pixels(nullptr)
+, w(0)
+, h(0)
+, levels(1)
+, decoded(nullptr)
+, mips()
+, blob() {
+
+}
+
+void TextureImage::reset(){
+	if(decoded) stbi_image_free(decoded);
+	decoded = nullptr;
+	mips = MipChain();
+	blob = ResourceHandle();
+	pixels = nullptr;
+	levels = 1;
+}
+
+const uint8_t* TextureImage::getLevel(int level) const {
+	assert(level >= 0 && level < levels);
+	if(level == 0){
+		return pixels;
+	} else if(blob){
+		return pixels + MipChain::levelOffset(w, h, level);
+	} else {
+		return mips.getLevel(level);
+	}
+}
+
+TextureImage::~TextureImage(){
+	reset();
+}
+
+TextureLoader::Request::Request(Texture2D& tex, MemBlock file, int levels)
+: tex(&tex)
+, file(file.ptr, file.ptr + file.size)
+, image()
+, w(0)
+, h(0)
+, levels(levels)
+, level(0)
+, rows_done(0)
+, target()
+, state(PENDING)
+, cancelled(false) {
+	std::tie(w, h) = tex.getSize();
+}
+
+TextureLoader::TextureLoader(Engine& e)
+: engine(e)
+, requests()
+, placeholder()
+, pbos()
+, pbo_sizes()
+, pbo_index(0)
+, use_pbos(false)
+, async(e.cfg->addVar<CVarBool>("r_tex_async", true))
+, use_cache(e.cfg->addVar<CVarBool>("r_tex_cache", true))
+, mipmaps(e.cfg->addVar<CVarBool>("r_tex_mipmaps", false))
+, upload_budget(e.cfg->addVar<CVarInt>("r_tex_upload_budget", 1024, 16, 65536)) {
+
+}
+
+bool TextureLoader::isAsync() const {
+	return async->val;
+}
+
+void TextureLoader::load(Texture2D& tex, MemBlock file){
+	assert(!tex.loader);
+
+	int w, h;
+	std::tie(w, h) = tex.getSize();
+
+	auto req = std::make_shared<Request>(tex, file, mipmaps->val ? MipChain::numLevels(w, h) : 1);
+	requests.push_back(req);
+	tex.loader = this;
+
+	const bool cached = use_cache->val;
+	const bool mipped = req->levels > 1;
+
+	engine.jobs->submit([this, req, cached, mipped]{
+		if(req->cancelled.load(std::memory_order_relaxed)) return;
+
+		bool ok = decode(MemBlock(req->file.data(), req->file.size()), req->image, cached, mipped);
+
+		req->w = req->image.w;
+		req->h = req->image.h;
+		req->levels = req->image.levels;
+		std::vector<uint8_t>().swap(req->file);
+
+		req->state.store(ok ? DECODED : FAILED, std::memory_order_release);
+	});
+}
+
+bool TextureLoader::decode(MemBlock file, TextureImage& out){
+	return decode(file, out, use_cache->val, mipmaps->val);
+}
+
+// called from worker threads, so only touches the thread-safe parts of ResourceSystem.
+bool TextureLoader::decode(MemBlock file, TextureImage& out, bool cached, bool mipped) const {
+	out.reset();
+
+	const uint32_t src_hash = str_hash_len(reinterpret_cast<const char*>(file.ptr), file.size);
+
+	char name[64] = {};
+	snprintf(name, sizeof(name), "texcache/%08x-%08x%s.tex", src_hash, uint32_t(file.size), mipped ? "-m" : "");
+
+	if(cached){
+		if(ResourceHandle rh = engine.res->loadUserFile(name)){
+			TexCacheHeader hdr = {};
+			if(rh.size() >= sizeof(hdr)){
+				memcpy(&hdr, rh.data(), sizeof(hdr));
+			}
+
+			if(hdr.magic    == tex_cache_magic
+			&& hdr.version  == tex_cache_version
+			&& hdr.src_hash == src_hash
+			&& hdr.src_size == file.size
+			&& hdr.format   == GL_RGBA8
+			&& hdr.levels   == uint32_t(mipped ? MipChain::numLevels(hdr.width, hdr.height) : 1)
+			&& rh.size() >= sizeof(hdr) + MipChain::levelOffset(hdr.width, hdr.height, hdr.levels)){
+				out.w      = hdr.width;
+				out.h      = hdr.height;
+				out.levels = hdr.levels;
+				out.pixels = rh.data() + sizeof(hdr);
+				out.blob   = std::move(rh);
+				return true;
+			}
+
+			log(logging::info, "Texture cache entry %s is stale, replacing it.", name);
+		}
+	}
+
+	out.decoded = stbi_load_from_memory(file.ptr, file.size, &out.w, &out.h, nullptr, 4);
+	if(!out.decoded) return false;
+	out.pixels = out.decoded;
+
+	if(mipped){
+		out.mips = MipChain(out.pixels, out.w, out.h);
+		out.levels = out.mips.getNumLevels();
+	}
+
+	if(cached){
+		const TexCacheHeader hdr = {
+			tex_cache_magic, tex_cache_version, src_hash, uint32_t(file.size),
+			GL_RGBA8, uint32_t(out.w), uint32_t(out.h), uint32_t(out.levels)
+		};
+
+		std::vector<uint8_t> blob(sizeof(hdr) + MipChain::levelOffset(out.w, out.h, out.levels));
+		memcpy(blob.data(), &hdr, sizeof(hdr));
+
+		for(int i = 0; i < out.levels; ++i){
+			const size_t off = MipChain::levelOffset(out.w, out.h, i);
+			const size_t len = MipChain::levelOffset(out.w, out.h, i + 1) - off;
+			memcpy(blob.data() + sizeof(hdr) + off, out.getLevel(i), len);
+		}
+
+		engine.res->saveUserFile(name, MemBlock(blob.data(), blob.size()));
+	}
+
+	return true;
+}
+
+void TextureLoader::cancel(Texture2D& tex){
+	auto it = std::find_if(requests.begin(), requests.end(), [&](const std::shared_ptr<Request>& r){
+		return r->tex == &tex;
+	});
+
+	if(it != requests.end()){
+		(*it)->cancelled = true;
+		dropTarget(**it);
+		requests.erase(it);
+	}
+
+	tex.loader = nullptr;
+}
+
+void TextureLoader::swapTargets(Texture2D& a, Texture2D& b){
+	for(auto& r : requests){
+		if(r->tex == &a){
+			r->tex = &b;
+		} else if(r->tex == &b){
+			r->tex = &a;
+		}
+	}
+}
+
+void TextureLoader::update(RenderState& rs){
+	if(requests.empty()) return;
+
+	if(!placeholder){
+		getPlaceholder();
+		rs.tex[rs.active_tex] = placeholder->id;
+	}
+
+	if(!pbos[0] && gl.MapBufferRange && gl.UnmapBuffer
+	&& (gl.version >= 21 || gl.hasExtension("ARB_pixel_buffer_object"))){
+		gl.GenBuffers(num_pbos, pbos);
+		use_pbos = true;
+	}
+
+	// budget is in KiB, but at least one row of something goes up each frame.
+	size_t budget = size_t(upload_budget->val) * 1024;
+
+	for(auto it = requests.begin(); it != requests.end() && budget > 0; /**/){
+		Request& req = **it;
+		int state = req.state.load(std::memory_order_acquire);
+
+		if(state == PENDING){
+			++it;
+			continue;
+		}
+
+		if(state == FAILED){
+			log(logging::error, "Couldn't decode texture data.");
+			req.tex->loader = nullptr;
+			it = requests.erase(it);
+			continue;
+		}
+
+		if(!req.target){
+			req.target = std::make_unique<Texture2D>(GL_UNSIGNED_BYTE, GL_RGBA8, req.w, req.h, nullptr, req.levels);
+			rs.tex[rs.active_tex] = req.target->id;
+		}
+
+		const int lw = std::max(1, req.w >> req.level), lh = std::max(1, req.h >> req.level);
+		const size_t row_bytes = lw * 4;
+		const int rows = std::min<size_t>(lh - req.rows_done, std::max<size_t>(budget / row_bytes, 1));
+
+		upload(req, rows, rs);
+		budget -= std::min(budget, rows * row_bytes);
+
+		if(req.rows_done == lh){
+			req.rows_done = 0;
+			req.level++;
+		}
+
+		if(req.level == req.levels){
+			req.image.reset();
+			// cleared first, so the move doesn't hand this request over to the target.
+			req.tex->loader = nullptr;
+			*req.tex = std::move(*req.target);
+			it = requests.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	if(use_pbos){
+		gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+}
+
+void TextureLoader::upload(Request& req, int rows, RenderState& rs){
+	const int lw = std::max(1, req.w >> req.level);
+	const size_t row_bytes = lw * 4;
+	const size_t bytes = rows * row_bytes;
+	const uint8_t* src = req.image.getLevel(req.level) + req.rows_done * row_bytes;
+
+	req.target->bind(rs.active_tex, rs);
+
+	// with the rows in a PBO, the pointer is an offset into it and the call returns
+	// without waiting. Otherwise the driver copies them out of src before returning.
+	if(use_pbos && uploadPBO(src, bytes)){
+		src = nullptr;
+	}
+
+	gl.TexSubImage2D(GL_TEXTURE_2D, req.level, 0, req.rows_done, lw, rows, GL_RGBA, GL_UNSIGNED_BYTE, src);
+
+	rs.stats.bytes_uploaded += bytes;
+	rs.stats.buffer_uploads++;
+
+	req.rows_done += rows;
+}
+
+// leaves the next PBO in the ring bound to GL_PIXEL_UNPACK_BUFFER holding the rows.
+bool TextureLoader::uploadPBO(const uint8_t* src, size_t bytes){
+	const size_t i = pbo_index;
+	pbo_index = (pbo_index + 1) % num_pbos;
+
+	gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[i]);
+
+	// invalidating gives back fresh storage if the GPU is still reading the old rows,
+	// so the map never waits on an upload from a previous frame.
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+
+	if(pbo_sizes[i] < bytes){
+		gl.BufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+		pbo_sizes[i] = bytes;
+	}
+
+	void* dst = gl.MapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags);
+	if(dst){
+		memcpy(dst, src, bytes);
+		// false means the contents got lost while mapped, send them directly instead.
+		if(gl.UnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) return true;
+	}
+
+	gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return false;
+}
+
+void TextureLoader::dropTarget(Request& req){
+	if(req.target){
+		// make sure a stale id from a lost context is cleared before deleting.
+		gl.validateObject(*req.target);
+		req.target.reset();
+	}
+	req.level = 0;
+	req.rows_done = 0;
+}
+
+const Texture2D& TextureLoader::getPlaceholder(){
+	if(!placeholder){
+		static const uint8_t checker[] = {
+			0xFF, 0x00, 0xFF, 0xFF,   0x00, 0x00, 0x00, 0xFF,
+			0x00, 0x00, 0x00, 0xFF,   0xFF, 0x00, 0xFF, 0xFF
+		};
+		placeholder = std::make_unique<Texture2D>(GL_UNSIGNED_BYTE, GL_RGBA8, 2, 2, checker);
+	}
+	return *placeholder;
+}
+
+void TextureLoader::onGLContextRecreate(){
+	std::fill(std::begin(pbos), std::end(pbos), 0);
+	std::fill(std::begin(pbo_sizes), std::end(pbo_sizes), 0);
+	pbo_index = 0;
+	use_pbos = false;
+
+	for(auto& r : requests){
+		dropTarget(*r);
+	}
+
+	if(placeholder){
+		gl.validateObject(*placeholder);
+		placeholder.reset();
+	}
+}
+
+TextureLoader::~TextureLoader(){
+	for(auto& r : requests){
+		r->cancelled = true;
+		r->tex->loader = nullptr;
+		dropTarget(*r);
+	}
+
+	if(pbos[0] && gl.initialized()){
+		gl.DeleteBuffers(num_pbos, pbos);
+	}
+}
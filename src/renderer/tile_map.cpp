@@ -0,0 +1,156 @@
+#include "tile_map.h"
+#include "material.h"
+#include "renderer.h"
+#include "camera.h"
+#include <climits>
+
+namespace {
+
+struct Vert {
+	Vert(int16_t x, int16_t y, uint16_t tx, uint16_t ty)
+		: x(x), y(y), tx(tx), ty(ty){}
+	int16_t x, y;
+	uint16_t tx, ty;
+};
+
+VERTEX_LAYOUT(vert_layout, Vert,
+	VATTR(Vert, x , "a_pos", 2),
+	VATTR(Vert, tx, "a_tex", 2, ATR_NORM)
+);
+
+}
+
+const uint16_t TileMap::empty;
+const int TileMap::chunk_size;
+
+TileMap::TileMap()
+: tiles()
+, chunks()
+, indices()
+, map_size(0, 0)
+, num_chunks(0, 0)
+, tile_size(0, 0)
+, tex_cells(1, 1)
+, camera(nullptr) {
+
+}
+
+TileMap::TileMap(Material& m, glm::ivec2 map_size, glm::ivec2 tile_size, glm::ivec2 tex_cells)
+: tiles(map_size.x * map_size.y, empty)
+, chunks()
+, indices(QuadIndexBuffer::get())
+, map_size(map_size)
+, num_chunks((map_size + (chunk_size - 1)) / chunk_size)
+, tile_size(tile_size)
+, tex_cells(tex_cells)
+, camera(nullptr) {
+	assert(tex_cells.x > 0 && tex_cells.y > 0);
+	assert(map_size.x * tile_size.x <= SHRT_MAX && map_size.y * tile_size.y <= SHRT_MAX);
+
+	Renderable proto(m.shader, &m.uniforms, RType{ GL_TRIANGLES });
+	proto.textures[0] = m.texture;
+	proto.samplers[0] = m.sampler;
+
+	const int total = num_chunks.x * num_chunks.y;
+	for(int i = 0; i < total; ++i){
+		chunks.emplace_back(new Chunk(proto));
+
+		Chunk& c = *chunks.back();
+		c.vao.setVertexBuffers({ &c.vertices });
+		c.vao.setIndexBuffer(indices.get());
+	}
+
+	indices->reserve(chunk_size * chunk_size);
+}
+
+TileMap::Chunk::Chunk(const Renderable& r)
+: vao()
+, vertices(MemBlock(nullptr, 0), vert_layout)
+, data()
+, renderable(r)
+, dirty(false) {
+	renderable.vertex_state = &vao;
+}
+
+void TileMap::setTile(glm::ivec2 pos, uint16_t tile){
+	if(pos.x < 0 || pos.y < 0 || pos.x >= map_size.x || pos.y >= map_size.y) return;
+
+	uint16_t& t = tiles[pos.y * map_size.x + pos.x];
+	if(t == tile) return;
+
+	t = tile;
+	chunks[(pos.y / chunk_size) * num_chunks.x + (pos.x / chunk_size)]->dirty = true;
+}
+
+uint16_t TileMap::getTile(glm::ivec2 pos) const {
+	if(pos.x < 0 || pos.y < 0 || pos.x >= map_size.x || pos.y >= map_size.y) return empty;
+	return tiles[pos.y * map_size.x + pos.x];
+}
+
+void TileMap::buildChunk(int cx, int cy){
+	Chunk& c = *chunks[cy * num_chunks.x + cx];
+
+	c.data.clear();
+
+	const int x0 = cx * chunk_size, x1 = std::min(x0 + chunk_size, map_size.x),
+	          y0 = cy * chunk_size, y1 = std::min(y0 + chunk_size, map_size.y);
+
+	size_t quads = 0;
+
+	for(int y = y0; y < y1; ++y){
+		for(int x = x0; x < x1; ++x){
+			const uint16_t t = tiles[y * map_size.x + x];
+			if(t == empty) continue;
+
+			const int fx = t % tex_cells.x, fy = t / tex_cells.x;
+
+			const uint16_t tx0 = (fx       / (float) tex_cells.x) * USHRT_MAX,
+			               ty0 = (fy       / (float) tex_cells.y) * USHRT_MAX,
+			               tx1 = ((fx + 1) / (float) tex_cells.x) * USHRT_MAX,
+			               ty1 = ((fy + 1) / (float) tex_cells.y) * USHRT_MAX;
+
+			const int16_t px0 = x * tile_size.x, px1 = px0 + tile_size.x,
+			              py0 = y * tile_size.y, py1 = py0 + tile_size.y;
+
+			const Vert quad[] = {
+				Vert(px0, py0, tx0, ty0),
+				Vert(px0, py1, tx0, ty1),
+				Vert(px1, py0, tx1, ty0),
+				Vert(px1, py1, tx1, ty1)
+			};
+
+			auto* p = reinterpret_cast<const uint8_t*>(quad);
+			c.data.insert(c.data.end(), p, p + sizeof(quad));
+			++quads;
+		}
+	}
+
+	c.vertices.setData(MemBlock(c.data.data(), c.data.size()));
+	c.renderable.count = quads * 6;
+	c.dirty = false;
+}
+
+void TileMap::draw(Renderer& r){
+	const glm::ivec2 chunk_px = tile_size * chunk_size;
+
+	for(int cy = 0; cy < num_chunks.y; ++cy){
+		for(int cx = 0; cx < num_chunks.x; ++cx){
+			Chunk& c = *chunks[cy * num_chunks.x + cx];
+
+			if(camera){
+				glm::vec3 lo(cx * chunk_px.x, cy * chunk_px.y, 0);
+				glm::vec3 hi(lo.x + chunk_px.x, lo.y + chunk_px.y, 0);
+
+				if(!camera->isBoxVisible(lo, hi)) continue;
+			}
+
+			if(c.dirty){
+				buildChunk(cx, cy);
+			}
+
+			if(c.renderable.count){
+				r.addRenderable(c.renderable);
+			}
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#include "uniform_buffer.h"
+#include "render_state.h"
+#include <cstring>
+
+const GLuint GlobalUniforms::binding;
+
+UniformBuffer::UniformBuffer(GLuint binding, size_t size)
+: data(size)
+, id(0)
+, binding(binding)
+, dirty(true) {
+	if(isSupported()) gl.GenBuffers(1, &id);
+}
+
+bool UniformBuffer::isSupported(){
+	return gl.BindBufferBase && gl.UniformBlockBinding;
+}
+
+void UniformBuffer::setData(const void* ptr, size_t size){
+	assert(size <= data.size());
+	memcpy(data.data(), ptr, size);
+	dirty = true;
+}
+
+void UniformBuffer::update(RenderState& rs){
+	if(!id) return;
+
+	if(dirty){
+		gl.BindBuffer(GL_UNIFORM_BUFFER, id);
+		gl.BufferData(GL_UNIFORM_BUFFER, data.size(), data.data(), GL_DYNAMIC_DRAW);
+		gl.BindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		rs.stats.bytes_uploaded += data.size();
+		rs.stats.buffer_uploads++;
+		dirty = false;
+	}
+
+	bind();
+}
+
+void UniformBuffer::bind(){
+	if(id) gl.BindBufferBase(GL_UNIFORM_BUFFER, binding, id);
+}
+
+void UniformBuffer::onGLContextRecreate(){
+	id = 0;
+	if(isSupported()) gl.GenBuffers(1, &id);
+	dirty = true;
+}
+
+UniformBuffer::~UniformBuffer(){
+	if(id && gl.initialized()) gl.DeleteBuffers(1, &id);
+}
@@ -116,6 +116,13 @@ static void parse_attribs(const char* fmt, ShaderAttribs& attrs, GLint& stride)
 
 }
 
+void VertexLayout::apply(ShaderAttribs& attrs) const {
+	for(size_t i = 0; i < count; ++i){
+		const VertexAttrib& at = attribs[i];
+		attrs.setAttribFormat(at.name_hash, at.type, at.nelem, at.off, at.flags);
+	}
+}
+
 void VertexBuffer::bind(RenderState& rs){
 	auto id = getID();
 	if(id && rs.vbo != id){
@@ -128,7 +135,8 @@ StaticVertexBuffer::StaticVertexBuffer()
 : data()
 , attrs()
 , stride(0)
-, id(0) {
+, id(0)
+, dirty(false) {
 
 }
 
@@ -136,9 +144,23 @@ StaticVertexBuffer::StaticVertexBuffer(const MemBlock& data, const char* fmt)
 : data(data)
 , attrs()
 , stride(0)
-, id(0) {
+, id(0)
+, dirty(false) {
 	parse_attribs(fmt, attrs, stride);
-	
+	init();
+}
+
+StaticVertexBuffer::StaticVertexBuffer(const MemBlock& data, const VertexLayout& layout)
+: data(data)
+, attrs()
+, stride(layout.stride)
+, id(0)
+, dirty(false) {
+	layout.apply(attrs);
+	init();
+}
+
+void StaticVertexBuffer::init(){
 	gl.GenBuffers(1, &id);
 	gl.BindBuffer(GL_ARRAY_BUFFER, id);
 	gl.BufferData(GL_ARRAY_BUFFER, data.size, data.ptr, GL_STATIC_DRAW);
@@ -160,8 +182,20 @@ GLuint StaticVertexBuffer::getID(void) const {
 	return id;
 }
 
-void StaticVertexBuffer::update(RenderState&){
+void StaticVertexBuffer::setData(const MemBlock& d){
+	data = d;
+	dirty = true;
+}
+
+void StaticVertexBuffer::update(RenderState& rs){
+	if(!dirty) return;
 
+	bind(rs);
+	gl.BufferData(GL_ARRAY_BUFFER, data.size, data.ptr, GL_STATIC_DRAW);
+	rs.stats.bytes_uploaded += data.size;
+	rs.stats.buffer_uploads++;
+
+	dirty = false;
 }
 
 void StaticVertexBuffer::onGLContextRecreate() {
@@ -169,11 +203,13 @@ void StaticVertexBuffer::onGLContextRecreate() {
 	gl.GenBuffers(1, &new_id);
 	DEBUGF("Reloading static vbo: [%d] -> [%d].", id, new_id);
 	id = new_id;
+	dirty = false;
 	gl.BindBuffer(GL_ARRAY_BUFFER, id);
 	gl.BufferData(GL_ARRAY_BUFFER, data.size, data.ptr, GL_STATIC_DRAW);
 }
 
 StaticVertexBuffer::~StaticVertexBuffer(){
+	gl.waitForFrame();
 	if(id && gl.initialized()){
 		gl.DeleteBuffers(1, &id);
 	}
@@ -183,6 +219,7 @@ DynamicVertexBuffer::DynamicVertexBuffer()
 : data()
 , attrs()
 , stride(0)
+, type_tag(nullptr)
 , stream_buf() {
 
 }
@@ -191,18 +228,36 @@ DynamicVertexBuffer::DynamicVertexBuffer(const char* fmt, size_t initial_capacit
 : data()
 , attrs()
 , stride(0)
+, type_tag(nullptr)
 , stream_buf(GL_ARRAY_BUFFER, data, true) {
 	parse_attribs(fmt, attrs, stride);
 	data.reserve(initial_capacity);	
 }
 
-void DynamicVertexBuffer::clear(){
-	data.clear();
-	stream_buf.mark();
+DynamicVertexBuffer::DynamicVertexBuffer(const VertexLayout& layout, size_t initial_capacity)
+: data()
+, attrs()
+, stride(layout.stride)
+, type_tag(layout.tag)
+, stream_buf(GL_ARRAY_BUFFER, data, true) {
+	layout.apply(attrs);
+	data.reserve(initial_capacity);
+}
+
+size_t DynamicVertexBuffer::alloc(size_t count){
+	return stream_buf.alloc(count * stride) / stride;
+}
+
+bool DynamicVertexBuffer::extend(size_t index, size_t count, size_t new_count){
+	return stream_buf.extend(BufferRange{ index * stride, count * stride }, new_count * stride);
 }
 
-void DynamicVertexBuffer::invalidate(BufferRange&& range){
-	stream_buf.invalidate(std::move(range));
+void DynamicVertexBuffer::free(size_t index, size_t count){
+	stream_buf.free(BufferRange{ index * stride, count * stride });
+}
+
+void DynamicVertexBuffer::clear(){
+	stream_buf.clear();
 }
 
 void DynamicVertexBuffer::onGLContextRecreate(){
@@ -3,159 +3,257 @@
 #include "index_buffer.h"
 #include "render_state.h"
 
+uint32_t VertexState::next_serial = 1;
+bool VertexState::defer_deletes = false;
+std::vector<GLuint> VertexState::dead_vaos;
+
 VertexState::VertexState()
-: enabled_arrays()
-, active_attribs()
+: bindings()
 , vertex_buffers()
 , index_buffer(nullptr)
-, id(0)
+, current_vao(0)
+, serial(next_serial++)
 , using_vao(gl.GenVertexArrays != nullptr) {
-	
-	if(using_vao) gl.GenVertexArrays(1, &id);
+
 }
 
 void VertexState::setVertexBuffers(std::initializer_list<VertexBuffer*> buffers){
-	if(using_vao) gl.BindVertexArray(id);
-	
-	GLint vbo_bind_point = 0;
-	for(auto* buf : buffers){
-		if(using_vao && gl.BindVertexBuffer){
-			DEBUGF(
-				"BindVertexBuffer: bind_point: %d, id: %d, stride: %d.", 
-				vbo_bind_point, buf->getID(), buf->getStride()
-			);
-			gl.BindVertexBuffer(vbo_bind_point++, buf->getID(), 0, buf->getStride());
-		}
-		vertex_buffers.push_back(buf);
-	}
+	vertex_buffers.assign(buffers.begin(), buffers.end());
+	invalidate();
 }
 
 void VertexState::setIndexBuffer(IndexBuffer* buff){
-	// bind the index buffer upfront if using VAOs, otherwise do it in bind().
-	if(using_vao && buff){
-		gl.BindVertexArray(id);
-		gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, buff->getID());
-	}
-	
 	index_buffer = buff;
+	invalidate();
 }
 
-void VertexState::setAttribArrays(RenderState& rs, const ShaderAttribs& new_attribs){
-	//TODO: give ShaderAttribs some quick == function.
-	if(using_vao && id != rs.vao){
-		gl.BindVertexArray(id);
-		rs.vao = id;
+IndexBuffer* VertexState::getIndexBuffer(void){
+	return index_buffer;
+}
+
+void VertexState::setAttribArrays(RenderState& rs, GLuint program, const ShaderAttribs& attrs){
+	Binding* b = findBinding(program);
+
+	if(!b){
+		bindings.push_back(Binding{ program, 0, {}, {}, {}, 0 });
+		b = &bindings.back();
 	}
-	
-	std::bitset<16> new_enabled_arrays;
-	
-	TRACEF("Need to set %td attribs.", std::distance(new_attribs.begin(), new_attribs.end()));
 
-	auto& search_attribs = using_vao ? this->active_attribs : rs.active_attribs;
-	auto& attrib_arrays =  using_vao ? this->enabled_arrays : rs.enabled_attrib_arrays;
+	const bool stale = isStale(*b);
+
+	if(stale){
+		TRACEF("Resolving attribs for program %u.", program);
+		resolve(*b, attrs);
+	}
 
-	for(const auto& a : new_attribs){
-		if(using_vao && search_attribs.containsAttrib(a.name_hash, a.index)){
-			new_enabled_arrays[a.index] = 1;
-			TRACEF("Attrib %#x already active, skip.", a.name_hash);
-			continue;
+	if(using_vao){
+		if(stale){
+			setupVAO(rs, *b);
+		} else if(rs.vao != b->vao){
+			gl.BindVertexArray(b->vao);
+			rs.vao = b->vao;
 		}
-		
-		GLint vbo_bind_point = 0;
-		for(auto* vb : vertex_buffers){
-			DEBUGF("Checking buffer %p for attrib %u...", vb, a.name_hash);
-			const ShaderAttribs& vb_attribs = vb->getShaderAttribs();
-			
-			DEBUGF("Num attribs in buffer: %td.", 
-				std::distance(vb_attribs.begin(), vb_attribs.end()));
-			
-			if(vb_attribs.containsAttrib(a.name_hash, -1)){
-				if(using_vao && gl.VertexAttribBinding){
-					DEBUGF("Setting attrib-buffer binding: [%d] -> [%d]", 
-						a.index, vbo_bind_point);
-				
-					gl.VertexAttribBinding(a.index, vbo_bind_point);
-				} else {
-					DEBUGF("Binding buffer %p for attrib %u", vb, a.name_hash);
-					vb->bind(rs);
-				}
-				
-				vb_attribs.bind(a.name_hash, a.index, vb->getStride());
-				
-				if(using_vao || !rs.enabled_attrib_arrays[a.index]){
-					gl.EnableVertexAttribArray(a.index);
-				}
-				new_enabled_arrays[a.index] = 1;
-				
+		current_vao = b->vao;
+	} else if(stale || rs.attrib_vstate != serial || rs.attrib_program != program){
+		apply(rs, *b);
+	}
+}
+
+VertexState::Binding* VertexState::findBinding(GLuint program){
+	for(auto& b : bindings){
+		if(b.program == program) return &b;
+	}
+	return nullptr;
+}
+
+bool VertexState::isStale(const Binding& b) const {
+	if(b.serial != serial) return true;
+
+	for(size_t i = 0; i < vertex_buffers.size(); ++i){
+		if(b.buffer_ids[i] != vertex_buffers[i]->getID()) return true;
+	}
+
+	return index_buffer && b.buffer_ids.back() != index_buffer->getID();
+}
+
+void VertexState::resolve(Binding& b, const ShaderAttribs& attrs){
+	// read first, an invalidate() from the main thread meanwhile should still count.
+	const uint32_t resolved_serial = serial;
+
+	b.attribs.clear();
+	b.buffer_ids.clear();
+
+	for(auto* vb : vertex_buffers){
+		b.buffer_ids.push_back(vb->getID());
+	}
+	if(index_buffer){
+		b.buffer_ids.push_back(index_buffer->getID());
+	}
+
+	for(const auto& a : attrs){
+		if(a.index < 0) continue;
+
+		for(size_t i = 0; i < vertex_buffers.size(); ++i){
+			if(vertex_buffers[i]->getShaderAttribs().containsAttrib(a.name_hash, -1)){
+				DEBUGF("Attrib %#x [%d] -> buffer %zu.", a.name_hash, a.index, i);
+				b.attribs.push_back(AttribBinding{ a.name_hash, a.index, i });
 				break;
 			}
-			vbo_bind_point++;
 		}
 	}
 
-	auto enabled_array_diff = attrib_arrays & ~new_enabled_arrays;
-	
-	for(size_t i = 0; i < enabled_array_diff.size(); ++i){
-		if(enabled_array_diff[i]){
-			gl.DisableVertexAttribArray((GLint)i);
+	b.serial = resolved_serial;
+}
+
+void VertexState::setupVAO(RenderState& rs, Binding& b){
+	if(!b.vao){
+		gl.GenVertexArrays(1, &b.vao);
+		DEBUGF("New VAO [%d] for program %u.", b.vao, b.program);
+	}
+
+	gl.BindVertexArray(b.vao);
+	rs.vao = b.vao;
+
+	if(gl.BindVertexBuffer){
+		for(size_t i = 0; i < vertex_buffers.size(); ++i){
+			VertexBuffer* buf = vertex_buffers[i];
+			DEBUGF(
+				"BindVertexBuffer: bind_point: %zu, id: %d, stride: %d.",
+				i, buf->getID(), buf->getStride()
+			);
+			if(gl.VertexBindingDivisor){
+				gl.VertexBindingDivisor(i, buf->getShaderAttribs().isInstanced() ? 1 : 0);
+			}
+			gl.BindVertexBuffer(i, buf->getID(), 0, buf->getStride());
 		}
 	}
-	
-	search_attribs = new_attribs;
-	attrib_arrays = new_enabled_arrays;
+
+	if(index_buffer){
+		gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer->getID());
+		rs.ibo = index_buffer->getID();
+	}
+
+	std::bitset<16> enabled;
+
+	for(const auto& a : b.attribs){
+		VertexBuffer* vb = vertex_buffers[a.buffer];
+
+		if(gl.VertexAttribBinding){
+			gl.VertexAttribBinding(a.index, a.buffer);
+		} else {
+			vb->bind(rs);
+		}
+
+		vb->getShaderAttribs().bind(a.name_hash, a.index, vb->getStride());
+
+		if(!b.enabled[a.index]){
+			gl.EnableVertexAttribArray(a.index);
+		}
+		enabled[a.index] = 1;
+	}
+
+	auto diff = b.enabled & ~enabled;
+	for(size_t i = 0; i < diff.size(); ++i){
+		if(diff[i]) gl.DisableVertexAttribArray((GLint)i);
+	}
+
+	b.enabled = enabled;
 }
 
-IndexBuffer* VertexState::getIndexBuffer(void){
-	return index_buffer;
+void VertexState::apply(RenderState& rs, Binding& b){
+	std::bitset<16> enabled;
+
+	for(const auto& a : b.attribs){
+		VertexBuffer* vb = vertex_buffers[a.buffer];
+
+		vb->bind(rs);
+		vb->getShaderAttribs().bind(a.name_hash, a.index, vb->getStride());
+
+		if(!rs.enabled_attrib_arrays[a.index]){
+			gl.EnableVertexAttribArray(a.index);
+		}
+		enabled[a.index] = 1;
+	}
+
+	auto diff = rs.enabled_attrib_arrays & ~enabled;
+	for(size_t i = 0; i < diff.size(); ++i){
+		if(diff[i]) gl.DisableVertexAttribArray((GLint)i);
+	}
+
+	rs.enabled_attrib_arrays = enabled;
+	rs.attrib_vstate = serial;
+	rs.attrib_program = b.program;
+}
+
+// VAO names are kept and set up again on next use, so a name never gets freed and
+// reused while RenderState might still think it's bound. Only the serial changes here,
+// the bindings notice it themselves on the thread that draws with them.
+void VertexState::invalidate(){
+	serial = next_serial++;
 }
 
 void VertexState::bind(RenderState& rs){
-	if(using_vao && rs.vao != id){
-		gl.BindVertexArray(id);
-		rs.vao = id;
+	if(using_vao && current_vao && rs.vao != current_vao){
+		gl.BindVertexArray(current_vao);
+		rs.vao = current_vao;
 	}
-	
+
+	if(index_buffer && !using_vao){
+		index_buffer->bind(rs);
+	}
+}
+
+void VertexState::update(RenderState& rs){
 	for(auto* vb : vertex_buffers){
 		vb->update(rs);
 	}
 	
 	if(index_buffer){
-		if(!using_vao) index_buffer->bind(rs);	
 		index_buffer->update(rs);
 	}
 }
 
 void VertexState::onGLContextRecreate(){
-	GLuint new_id = 0;
-
-	enabled_arrays.reset();
-	active_attribs.clear();
-
-	if(using_vao){
-		gl.GenVertexArrays(1, &new_id);
-		gl.BindVertexArray(new_id);
-	}
+	DEBUGF("Reloading VState: dropping %zu cached bindings.", bindings.size());
 
-	DEBUGF("Reloading VState: vao id [%d] -> [%d].", id, new_id);
-	id = new_id;
+	// the old context's VAO names mean nothing now.
+	bindings.clear();
+	current_vao = 0;
+	serial = next_serial++;
 
-	GLint vbo_bind_point = 0;
 	for(auto* buf : vertex_buffers){
 		gl.validateObject(*buf);
-		if(gl.BindVertexBuffer){
-			DEBUGF(
-				"BindVertexBuffer: bind_point: %d, id: %d, stride: %d.", 
-				vbo_bind_point, buf->getID(), buf->getStride()
-			);
-			gl.BindVertexBuffer(vbo_bind_point++, buf->getID(), 0, buf->getStride());
-		}
 	}
 
-	if(index_buffer) gl.validateObject(*index_buffer);
+	if(index_buffer){
+		gl.validateObject(*index_buffer);
+	}
 }
 
 VertexState::~VertexState(){
-	if(using_vao && id && gl.initialized()){
-		gl.DeleteVertexArrays(1, &id);
+	gl.waitForFrame();
+	if(!gl.initialized()) return;
+
+	for(auto& b : bindings){
+		if(!b.vao) continue;
+
+		// VAOs aren't shared between contexts, this one only exists in the render thread's.
+		if(defer_deletes){
+			dead_vaos.push_back(b.vao);
+		} else {
+			gl.DeleteVertexArrays(1, &b.vao);
+		}
 	}
 }
+
+void VertexState::deferVAODeletes(bool defer){
+	defer_deletes = defer;
+
+	// either deleted along with the render context, or never queued.
+	dead_vaos.clear();
+}
+
+void VertexState::takeDeadVAOs(std::vector<GLuint>& out){
+	out.insert(out.end(), dead_vaos.begin(), dead_vaos.end());
+	dead_vaos.clear();
+}
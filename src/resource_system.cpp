@@ -13,7 +13,9 @@ using namespace std;
 	extern "C" char INTERNAL_ZIP(start)[], INTERNAL_ZIP(end)[];
 #endif
 
-ResourceSystem::ResourceSystem(const char* argv0){
+ResourceSystem::ResourceSystem(const char* argv0, const char* app_name)
+: resources()
+, has_write_dir(false) {
 	if(!PHYSFS_init(argv0)){
 		log(logging::error, "PhysFS init Error: %s", PHYSFS_getLastError());
 	}
@@ -31,6 +33,14 @@ ResourceSystem::ResourceSystem(const char* argv0){
 	if(!PHYSFS_mount(path, NULL, 0)){
 		log(logging::info, "Couldn't mount ./data/: %s", PHYSFS_getLastError());
 	}
+
+	// the write dir is also mounted read-only under user/ so loadUserFile can find things.
+	const char* pref = PHYSFS_getPrefDir("engine", app_name);
+	if(pref && PHYSFS_setWriteDir(pref) && PHYSFS_mount(pref, "user", 1)){
+		has_write_dir = true;
+	} else {
+		log(logging::info, "No user write dir: %s", PHYSFS_getLastError());
+	}
 }
 
 ResourceHandle ResourceSystem::load(const char* name){
@@ -56,6 +66,36 @@ size_t ResourceSystem::getUseCount(const char* name){
 	}
 }
 
+ResourceHandle ResourceSystem::loadUserFile(const char* name){
+	if(!has_write_dir) return ResourceHandle();
+
+	char path[PATH_MAX] = {};
+	snprintf(path, sizeof(path), "user/%s", name);
+
+	return import(path);
+}
+
+bool ResourceSystem::saveUserFile(const char* name, MemBlock data){
+	if(!has_write_dir) return false;
+
+	if(const char* slash = strrchr(name, '/')){
+		char dir[PATH_MAX] = {};
+		snprintf(dir, sizeof(dir), "%.*s", int(slash - name), name);
+		PHYSFS_mkdir(dir);
+	}
+
+	PHYSFS_File* f = PHYSFS_openWrite(name);
+	if(!f){
+		log(logging::warn, "Couldn't write user file %s: %s", name, PHYSFS_getLastError());
+		return false;
+	}
+
+	bool ok = PHYSFS_writeBytes(f, data.ptr, data.size) == PHYSFS_sint64(data.size);
+	PHYSFS_close(f);
+
+	return ok;
+}
+
 ResourceHandle ResourceSystem::import(const char* name){
 	uint8_t* file_data = nullptr;
 	size_t file_size = 0;
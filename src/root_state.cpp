@@ -2,13 +2,25 @@
 #include "root_state.h"
 #include "input.h"
 #include "cli.h"
+#include "config.h"
+#include "renderer.h"
+#include <cstdio>
+#include <algorithm>
 
 enum {
 	ACTION_QUIT,
 	ACTION_TOGGLE_CONSOLE
 };
 
-RootState::RootState(Engine& e) {
+static const int      STATS_FONT_SZ   = 16;
+static const uint32_t STATS_UPDATE_MS = 250;
+
+RootState::RootState(Engine& e)
+: engine        (e)
+, stats_overlay (e.cfg->addVar<CVarBool>("r_stats_overlay", false))
+, font          (e, { "DejaVuSansMono.ttf" }, STATS_FONT_SZ)
+, stats_text    (e, font, { 0, 0 }, "")
+, stats_time    (0) {
 	e.input->subscribe(this, "menu", ACTION_QUIT);
 	e.input->subscribe(this, "console", ACTION_TOGGLE_CONSOLE);
 }
@@ -17,8 +29,47 @@ void RootState::update(Engine& e, uint32_t delta){
 
 }
 
+void RootState::updateStats(){
+	const RenderStats& stats = engine.renderer->getStats();
+	const auto& gpu_times = engine.renderer->getGpuTimes();
+
+	alt::StrMut str;
+	char buf[128];
+
+	snprintf(buf, sizeof(buf), "upload: %zu bytes / %zu calls\n", stats.bytes_uploaded, stats.buffer_uploads);
+	str.append(buf);
+
+	snprintf(buf, sizeof(buf), "scale: %.2f\n", engine.renderer->getRenderScale());
+	str.append(buf);
+
+	if(!gpu_times.empty()){
+		snprintf(buf, sizeof(buf), "gpu: %.2f ms\n", engine.renderer->getGpuFrameMs());
+		str.append(buf);
+		for(auto& t : gpu_times){
+			snprintf(buf, sizeof(buf), "  %-12s %6.2f ms\n", t.label ? t.label : "(other)", t.ms);
+			str.append(buf);
+		}
+	}
+
+	int lines = std::count(str.begin(), str.end(), '\n');
+	stats_text.update(str, { 0, engine.renderer->window_h - lines * STATS_FONT_SZ });
+}
+
+// refreshed from here rather than update(), which only runs for the top state.
 void RootState::draw(Renderer& r){
+	if(!stats_overlay->val) return;
+
+	const uint32_t now = SDL_GetTicks();
+	if(!stats_time || now - stats_time >= STATS_UPDATE_MS){
+		updateStats();
+		stats_time = now;
+	}
 
+	r.setLayer(Renderer::LAYER_UI);
+	r.setLabel("stats");
+	stats_text.draw(r);
+	r.setLabel(nullptr);
+	r.setLayer(Renderer::LAYER_SCENE);
 }
 
 bool RootState::onInput(Engine& e, int action_id, bool pressed){
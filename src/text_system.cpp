@@ -6,8 +6,8 @@
 namespace {
 
 struct TextVert {
-	TextVert(int16_t x, int16_t y, uint16_t tx, uint16_t ty, uint32_t c = 0xffffffff)
-	: x(x), y(y), tex_x(tx), tex_y(ty) {
+	TextVert(int16_t x, int16_t y, uint16_t tx, uint16_t ty, uint32_t c = 0xffffffff, uint16_t layer = 0)
+	: x(x), y(y), tex_x(tx), tex_y(ty), layer(layer), pad(0) {
 		color[0] = c >> 24;
 		color[1] = c >> 16;
 		color[2] = c >> 8;
@@ -17,8 +17,16 @@ struct TextVert {
 	int16_t x, y;
 	uint16_t tex_x, tex_y;
 	uint8_t color[4];
+	uint16_t layer, pad; // only read by text_array.glslv.
 };
 
+VERTEX_LAYOUT(text_layout, TextVert,
+	VATTR(TextVert, x    , "a_pos"  , 2),
+	VATTR(TextVert, tex_x, "a_tex"  , 2, ATR_NORM),
+	VATTR(TextVert, color, "a_col"  , 4, ATR_NORM),
+	VATTR(TextVert, layer, "a_layer", 1)
+);
+
 static char32_t COLORCODE_START = 0xfdd0;
 static size_t COLORCODE_COUNT = 16;
 
@@ -52,10 +60,13 @@ size_t count_verts(const alt::StrRef32& str){
 TextSystem::TextSystem(Engine& e)
 : ft_lib(nullptr)
 , v_state()
-, text_buffer("a_pos:2s|a_tex:2SN|a_col:4BN", 512)
+, text_buffer(text_layout, 512)
 , text_vs(e, { "text.glslv" })
 , text_fs(e, { "text.glslf" })
 , text_shader(text_vs, text_fs)
+, text_array_vs(e, { "text_array.glslv" })
+, text_array_fs(e, { "text_array.glslf" })
+, text_array_shader(text_array_vs, text_array_fs)
 , blend_mode{{{ GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA }}} {
 	assert(FT_Init_FreeType(&ft_lib) == 0);
 	text_shader.link();
@@ -66,7 +77,7 @@ FT_Library& TextSystem::getLib(){
 	return ft_lib;
 }
 
-size_t TextSystem::writeString(Text& t, glm::ivec2 pos, const alt::StrRef32& str){
+size_t TextSystem::writeString(Text& t, size_t index, glm::ivec2 pos, const alt::StrRef32& str){
 	const Font& f = *t.font;
 
 	size_t str_len = str.size(),
@@ -75,14 +86,17 @@ size_t TextSystem::writeString(Text& t, glm::ivec2 pos, const alt::StrRef32& str
 		   w = 0,
 		   h = f.getLineHeight();
 	
-	int tw = 0, th = 0;
-	std::tie(tw, th) = f.getTexture()->getSize();
+	const glm::ivec2 tex_size = f.getTextureSize();
+	const uint16_t layer = f.getLayer();
 
-	float x_scale = USHRT_MAX / (float)tw,
-	      y_scale = USHRT_MAX / (float)th;
+	float x_scale = USHRT_MAX / (float)tex_size.x,
+	      y_scale = USHRT_MAX / (float)tex_size.y;
 
 	uint32_t current_color = t.palette[COLORCODE_COUNT - 1]; // white in default palette
 	size_t num_verts = 0;
+
+	// callers have already allocated count_verts(str) vertices at index.
+	BufferSpan<TextVert> verts = text_buffer.write<TextVert>(index, count_verts(str));
 	char32_t prev_char = 0;
 	
 	for(size_t i = 0; i < str_len; ++i){
@@ -124,12 +138,13 @@ size_t TextSystem::writeString(Text& t, glm::ivec2 pos, const alt::StrRef32& str
 		         ty1 = (ginfo.y + h) * y_scale,
 				 w2  = w + ginfo.width;
 		
-		text_buffer.push(TextVert(x + w , y + 0, tx0, ty0, current_color));
-		text_buffer.push(TextVert(x + w , y + h, tx0, ty1, current_color));
-		text_buffer.push(TextVert(x + w2, y + 0, tx1, ty0, current_color));
-		text_buffer.push(TextVert(x + w2, y + 0, tx1, ty0, current_color));
-		text_buffer.push(TextVert(x + w , y + h, tx0, ty1, current_color));
-		text_buffer.push(TextVert(x + w2, y + h, tx1, ty1, current_color));
+		TextVert* v = verts.begin() + num_verts;
+		v[0] = TextVert(x + w , y + 0, tx0, ty0, current_color, layer);
+		v[1] = TextVert(x + w , y + h, tx0, ty1, current_color, layer);
+		v[2] = TextVert(x + w2, y + 0, tx1, ty0, current_color, layer);
+		v[3] = TextVert(x + w2, y + 0, tx1, ty0, current_color, layer);
+		v[4] = TextVert(x + w , y + h, tx0, ty1, current_color, layer);
+		v[5] = TextVert(x + w2, y + h, tx1, ty1, current_color, layer);
 
 		num_verts += 6;
 		w += ginfo.advance - ginfo.bearing_x;
@@ -142,13 +157,20 @@ size_t TextSystem::writeString(Text& t, glm::ivec2 pos, const alt::StrRef32& str
 }
 
 void TextSystem::addText(Text& t){
-	const GLint off = text_buffer.getSize();
-	const GLsizei count = writeString(t, t.start_pos, t.str);
+	const GLint off = text_buffer.alloc(count_verts(t.str));
+	const GLsizei count = writeString(t, off, t.start_pos, t.str);
+
+	// fonts in an array TextureAtlas sample their layer of it, only linked once needed.
+	ShaderProgram* shader = &text_shader;
+	if(t.font->getTexture()->getType() == GL_TEXTURE_2D_ARRAY){
+		text_array_shader.link();
+		shader = &text_array_shader;
+	}
 
 	text_renderables.push_back(
 		Renderable(
 			&v_state,
-			&text_shader, 
+			shader, 
 			blend_mode, 
 			RType{GL_TRIANGLES}, 
 			RCount{count}, 
@@ -162,45 +184,42 @@ void TextSystem::addText(Text& t){
 void TextSystem::updateText(Text& t, const alt::StrRef32& newstr, glm::ivec2 newpos){
 	if(!t.renderable) return;
 
+	Renderable* r = t.renderable;
 	bool pos_changed = t.start_pos != newpos;
-	// if this is only appending text, and it's at the end of the vertex buffer,
-	// then we can just push the new characters on the end.
+
+	// if this is only appending text, and the block can grow in place,
+	// then we can just write the new characters on the end.
 	if(!pos_changed
 	&& newstr.size() >= t.str.size()
-	&& size_t(t.renderable->offset + t.renderable->count) == text_buffer.getSize()
 	&& newstr.find(t.str) == 0){
 
 		alt::StrRef32 suffix(newstr.data() + t.str.size(), newstr.size() - t.str.size());
-		
-		t.renderable->count += writeString(
-			t,
-			t.end_pos,
-			suffix
-		);
-		t.str.append(suffix);
+		const size_t extra = count_verts(suffix);
 
-	} else {
-		// if the new text is a substring of the old text starting at offset 0, then don't 
-		// add to the vertex buffer, just lower the renderable's count and invalidate the end.
-		if(!t.str.empty() && t.str.find(newstr) == 0 && !pos_changed){
-			size_t start = t.renderable->offset * sizeof(TextVert),
-			       count = t.renderable->count * sizeof(TextVert),
-			       verts = count_verts(newstr),
-				   bytes = verts * sizeof(TextVert);
+		if(text_buffer.extend(r->offset, r->count, r->count + extra)){
+			r->count += writeString(t, r->offset + r->count, t.end_pos, suffix);
+			t.str.append(suffix);
+			return;
+		}
+	}
 
-			text_buffer.invalidate(BufferRange{ start + bytes, count - bytes, this });
+	// if the new text is a substring of the old text starting at offset 0, then don't 
+	// write anything, just lower the renderable's count and free the end.
+	if(!t.str.empty() && t.str.find(newstr) == 0 && !pos_changed){
+		const size_t verts = count_verts(newstr);
 
-			t.renderable->count = verts;
-			t.str = alt::StrMut32(newstr);
-			t.end_pos = t.getPos(newstr.size());
+		text_buffer.free(r->offset + verts, r->count - verts);
 
-		} else {
-			// otherwise we'll have to invalidate all the old vertices and append new ones.
-			delText(t);
-			t.str = alt::StrMut32(newstr);
-			t.start_pos = newpos;
-			addText(t);
-		}
+		r->count = verts;
+		t.str = alt::StrMut32(newstr);
+		t.end_pos = t.getPos(newstr.size());
+
+	} else {
+		// otherwise we'll have to free all the old vertices and allocate new ones.
+		delText(t);
+		t.str = alt::StrMut32(newstr);
+		t.start_pos = newpos;
+		addText(t);
 	}
 }
 
@@ -209,11 +228,7 @@ void TextSystem::delText(Text& t){
 
 	if(!r) return;
 
-	size_t start = r->offset * sizeof(TextVert);
-	size_t count = r->count * sizeof(TextVert);
-	if(count > 0){
-		text_buffer.invalidate(BufferRange{ start, count, this });
-	}
+	text_buffer.free(r->offset, r->count);
 
 	auto i = text_renderables.begin();
 	for(auto j = text_renderables.end(); i != j; ++i){
@@ -226,14 +241,6 @@ void TextSystem::delText(Text& t){
 	t.renderable = nullptr;
 }
 
-void TextSystem::onBufferRangeInvalidated(size_t off, size_t len){
-	for(auto& r : text_renderables){
-		if(r.offset * sizeof(TextVert) > off){
-			r.offset -= (len / sizeof(TextVert));
-		}
-	}
-}
-
 TextSystem::~TextSystem(){
 	FT_Done_FreeType(ft_lib);
 }
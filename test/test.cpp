@@ -4,6 +4,17 @@
 #include "engine.h"
 #include "config.h"
 #include "shader_uniforms.h"
+#include "buffer_common.h"
+#include "render_state.h"
+#include "enums.h"
+#include "camera.h"
+#include "texture_atlas.h"
+#include "texture.h"
+#include "vertex_layout.h"
+#include "png_writer.h"
+#include "resource_system.h"
+#include "stb/stb_image.h"
+#include <physfs.h>
 #include "test_state.h"
 #include "test_collision_state.h"
 
@@ -52,6 +63,555 @@ void test_shader_uniforms(int, char**){
 	}
 }
 
+void test_buffer_alloc(int, char**){
+	BufferAllocator a;
+
+	size_t b0 = a.alloc(16), b1 = a.alloc(32), b2 = a.alloc(16);
+	assert(b0 == 0 && b1 == 16 && b2 == 48 && a.size() == 64);
+
+	// freed blocks are reused in place, without moving their neighbours.
+	a.free({ b1, 32 });
+	assert(a.alloc(8) == 16);
+	assert(a.alloc(24) == 24);
+
+	// neighbouring free blocks merge, and a free tail shrinks the buffer.
+	a.free({ 16, 8 });
+	a.free({ 24, 24 });
+	assert(a.alloc(32) == 16);
+	a.free({ 16, 32 });
+	a.free({ b2, 16 });
+	assert(a.size() == 16);
+
+	assert(a.extend({ b0, 16 }, 40) && a.size() == 40);
+	assert(a.extend({ b0, 40 }, 8)  && a.size() == 8);
+
+	puts("ok");
+}
+
+// what StreamingBuffer::update sends after the buffer shrinks and is written again.
+void test_streaming_buffer(int argc, char** argv){
+	Engine e(argc, argv, "Test");
+	gl.streaming_mode->set(BUFFER_INVALIDATE);
+
+	std::vector<uint8_t> data;
+	data.reserve(256);
+	StreamingBuffer buf(GL_ARRAY_BUFFER, data, true);
+	RenderState rs = {};
+
+	auto upload = [&]{
+		rs.stats = {};
+		buf.update(rs);
+		return rs.stats.bytes_uploaded;
+	};
+
+	buf.append(128);
+	buf.mark();
+	assert(upload() == 128);
+
+	// refilling after a clear has to re-send everything, even to the same or a smaller size.
+	buf.clear();
+	buf.append(128);
+	buf.mark();
+	assert(upload() == 128);
+
+	buf.clear();
+	buf.append(64);
+	buf.mark();
+	assert(upload() == 64);
+
+	// as does appending over a freed tail.
+	buf.free({ 32, 32 });
+	buf.append(32);
+	buf.mark();
+	assert(upload() == 32);
+
+	// with nothing written, nothing is sent.
+	buf.mark();
+	assert(upload() == 0);
+
+	puts("ok");
+}
+
+void test_atlas_packer(int argc, char** argv){
+	glm::ivec2 pos;
+
+	// a rect the size of the page fills it exactly, leaving no room for anything else.
+	SkylinePacker exact(64, 64);
+	assert(exact.pack(64, 64, pos) && pos == glm::ivec2(0, 0));
+	assert(!exact.pack(1, 1, pos));
+
+	SkylinePacker small(64, 64);
+	assert(!small.pack(65, 8, pos) && !small.pack(8, 65, pos));
+
+	// whatever gets placed stays inside the page, and never overlaps anything else.
+	SkylinePacker packer(256, 256);
+	std::vector<glm::ivec4> placed;
+	uint32_t rng = 12345;
+
+	for(int i = 0; i < 200; ++i){
+		rng = rng * 1103515245 + 12345;
+		const int w = 4 + (rng >> 16) % 40, h = 4 + (rng >> 8) % 40;
+
+		if(packer.pack(w, h, pos)){
+			assert(pos.x >= 0 && pos.y >= 0 && pos.x + w <= 256 && pos.y + h <= 256);
+			placed.push_back(glm::ivec4(pos, w, h));
+		}
+	}
+	assert(placed.size() > 20);
+
+	for(size_t i = 0; i < placed.size(); ++i){
+		for(size_t j = i + 1; j < placed.size(); ++j){
+			const glm::ivec4 &a = placed[i], &b = placed[j];
+			assert(a.x + a.z <= b.x || b.x + b.z <= a.x || a.y + a.w <= b.y || b.y + b.w <= a.y);
+		}
+	}
+
+	// two padded 32px images can't share a 64px page, so the atlas opens a second one.
+	Engine e(argc, argv, "Test");
+	TextureAtlas atlas(e, { "test_sprite.png", "test_sprite.png" }, 64, 1);
+	assert(atlas.getNumPages() == 2);
+	assert(atlas.regions.size() == 2 && atlas.regions[0].page == 0 && atlas.regions[1].page == 1);
+
+	puts("ok");
+}
+
+// sprites from an array TextureAtlas and text in a font added to it all share one binding,
+// so batches drawing different pages don't need separate materials or texture binds.
+void test_atlas_array(int argc, char** argv){
+	Engine e(argc, argv, "Test");
+
+	if(!Texture2DArray::isSupported()){
+		puts("skipped, no array textures");
+		return;
+	}
+
+	TextureAtlas atlas(e, { "test_sprite.png" }, 256, 1, true);
+	const Texture2DArray* array = atlas.getArray();
+	assert(array && array->getLayers() == 1);
+
+	const AtlasRegion* region = atlas.getRegion("test_sprite.png");
+	assert(region && region->page == 0);
+
+	// the glyphs go in a page of their own after the sprites.
+	ResourceHandle font_data = e.res->load("LiberationSans-Regular.ttf");
+	Font font(e, MemBlock(font_data.data(), font_data.size()), 12);
+	Font* font_ptr = &font;
+
+	assert(font.addToAtlas(atlas));
+	assert(font.getTexture() == array && font.getLayer() == 1 && array->getLayers() == 2);
+
+	Resource<VertShader> vs(e, {"sprite_array.glslv"}), inst_vs(e, {"sprite_array_instanced.glslv"});
+	Resource<FragShader> fs(e, {"sprite_array.glslf"});
+	ShaderProgram shader(vs, fs), inst_shader(inst_vs, fs);
+	assert(shader.link() && inst_shader.link());
+
+	Material mat(shader, *array);
+	SpriteBatch a(mat), b(mat, inst_shader);
+	Sprite sa(a, { 100, 100 }, { 32, 32 }), sb(b, { 200, 100 }, { 32, 32 });
+	sa.setRegion(region);
+	sb.setRegion(region);
+
+	Text text(e, Proxy<Font>(font_ptr), { 10, 10 }, "Hi");
+
+	CommandList& cl = e.renderer->getCommandList();
+	a.draw(cl);
+	b.draw(cl);
+	text.draw(*e.renderer);
+
+	assert(cl.size() == 3);
+	for(auto* r : cl){
+		assert(r->textures[0] == array);
+	}
+	assert(cl.begin()[2]->shader == &e.text->text_array_shader);
+	cl.clear();
+
+	// TextVert is 16 bytes, with the layer at 12.
+	uint16_t text_layer = 0;
+	memcpy(&text_layer, e.text->text_buffer.data.data() + text.renderable->offset * 16 + 12, 2);
+	assert(text_layer == 1);
+
+	puts("ok");
+}
+
+// the 3.30 shaders read the Renderer's globals from the std140 block, 1.20 ones still get them per-uniform.
+void test_globals_block(int argc, char** argv){
+	Engine e(argc, argv, "Test");
+
+	if(!UniformBuffer::isSupported() || gl.version < 33){
+		puts("skipped, no GLSL 3.30 uniform blocks");
+		return;
+	}
+
+	Resource<VertShader> vs(e, {"sprite_330.glslv"}), text_vs(e, {"text_330.glslv"}), old_vs(e, {"sprite.glslv"});
+	Resource<FragShader> fs(e, {"sprite_330.glslf"}), text_fs(e, {"text_330.glslf"}), old_fs(e, {"sprite.glslf"});
+	ShaderProgram shader(vs, fs), text_shader(text_vs, text_fs), old_shader(old_vs, old_fs);
+
+	assert(shader.link() && text_shader.link() && old_shader.link());
+	assert(shader.usesGlobals() && text_shader.usesGlobals() && !old_shader.usesGlobals());
+
+	const GLuint block = gl.GetUniformBlockIndex(shader.program_id, GlobalUniforms::block_name);
+	GLint binding = -1, size = 0;
+	gl.GetActiveUniformBlockiv(shader.program_id, block, GL_UNIFORM_BLOCK_BINDING, &binding);
+	gl.GetActiveUniformBlockiv(shader.program_id, block, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+	assert(binding == GlobalUniforms::binding && size == sizeof(GlobalUniforms));
+
+	// block members have no location, so only the old program has a u_ortho of its own.
+	auto has_ortho = [](const ShaderProgram& p){
+		auto& info = p.uniforms.uniform_info;
+		return std::find(info.begin(), info.end(), str_hash("u_ortho")) != info.end();
+	};
+	assert(!has_ortho(shader) && has_ortho(old_shader));
+
+	puts("ok");
+}
+
+void test_camera(int, char**){
+	Camera c;
+	c.setOrtho({ 640, 480 });
+
+	assert(c.isPointVisible({ 320, 240, 0 }));
+	assert(!c.isPointVisible({ 700, 240, 0 }));
+	assert(c.isBoxVisible({ 600, 400, 0 }, { 700, 500, 0 }));
+	assert(!c.isBoxVisible({ -100, -100, 0 }, { -10, -10, 0 }));
+
+	// scrolling right should bring the box on the right into view, and lose the origin.
+	c.move({ 640, 0, 0 });
+	assert(c.isPointVisible({ 700, 240, 0 }));
+	assert(!c.isPointVisible({ 320, 240, 0 }));
+	assert(c.isSphereVisible({ 630, 240, 0 }, 20));
+
+	puts("ok");
+}
+
+void test_tilemap(int argc, char** argv){
+	Engine e(argc, argv, "Test");
+	Resource<VertShader> vs(e, {"sprite.glslv"});
+	Resource<FragShader> fs(e, {"sprite.glslf"});
+	ShaderProgram shader(vs, fs);
+	Material mat(shader);
+
+	// 16px tiles in chunks of 32 make 512px chunks, so a 3x2 grid of them.
+	TileMap map(mat, { 80, 40 }, { 16, 16 }, { 4, 4 });
+	Camera cam;
+	cam.setOrtho({ 640, 480 });
+	map.setCamera(&cam);
+
+	for(int i = 0; i < 3; ++i) map.setTile({ i, 0 }, 1);       // chunk (0, 0)
+	for(int i = 0; i < 5; ++i) map.setTile({ 32 + i, 5 }, 2);  // chunk (1, 0)
+	map.setTile({ 70, 0 }, 3);                                 // chunk (2, 0)
+	map.setTile({ 0, 35 }, 3);                                 // chunk (0, 1)
+	assert(map.getTile({ 33, 5 }) == 2 && map.getTile({ 1, 1 }) == TileMap::empty);
+
+	CommandList& cl = e.renderer->getCommandList();
+
+	auto counts = [&]{
+		std::vector<GLsizei> c;
+		for(auto* r : cl) c.push_back(r->count);
+		cl.clear();
+		return c;
+	};
+
+	// only the two chunks in view get built and drawn, with 6 indices per tile.
+	map.draw(*e.renderer);
+	assert((counts() == std::vector<GLsizei>{ 3 * 6, 5 * 6 }));
+	assert(map.chunks[2]->dirty && map.chunks[3]->dirty);
+
+	cam.move({ 600, 0, 0 });
+	map.draw(*e.renderer);
+	assert((counts() == std::vector<GLsizei>{ 5 * 6, 1 * 6 }));
+
+	// clearing a tile rebuilds its chunk, setting the same one again doesn't.
+	map.setTile({ 32, 5 }, TileMap::empty);
+	map.setTile({ 70, 0 }, 3);
+	assert(map.chunks[1]->dirty && !map.chunks[2]->dirty);
+	map.draw(*e.renderer);
+	assert((counts() == std::vector<GLsizei>{ 4 * 6, 1 * 6 }));
+
+	// out of range is ignored.
+	map.setTile({ 80, 0 }, 1);
+	assert(map.getTile({ 80, 0 }) == TileMap::empty);
+
+	puts("ok");
+}
+
+// a page's bounds follow its sprites, so scrolling them all out of view culls it.
+void test_sprite_culling(int argc, char** argv){
+	Engine e(argc, argv, "Test");
+	Resource<VertShader> vs(e, {"sprite.glslv"});
+	Resource<FragShader> fs(e, {"sprite.glslf"});
+	ShaderProgram shader(vs, fs);
+	Material mat(shader);
+
+	SpriteBatch batch(mat);
+	Camera cam;
+	cam.setOrtho({ 640, 480 });
+	batch.setCamera(&cam);
+
+	auto drawn = [&]{
+		CommandList cl;
+		batch.draw(cl);
+		return cl.size();
+	};
+
+	std::unique_ptr<Sprite> a(new Sprite(batch, { 100, 100 }, { 16, 16 }));
+	Sprite b(batch, { 1000, 100 }, { 16, 16 });
+	assert(drawn() == 1);
+
+	for(int x = 100; x < 1000; x += 50){
+		a->setPosition({ x, 100 });
+		assert(drawn() == (x - 8 < 640 ? 1u : 0u));
+	}
+
+	// removing the only sprite in view swaps b into its slot, and shrinks the page to b.
+	a->setPosition({ 100, 100 });
+	assert(drawn() == 1);
+	a.reset();
+	assert(drawn() == 0);
+
+	cam.move({ 640, 0, 0 });
+	assert(drawn() == 1);
+
+	puts("ok");
+}
+
+void test_mip_chain(int, char**){
+	assert(MipChain::numLevels(1, 1) == 1);
+	assert(MipChain::numLevels(4, 1) == 3);
+	assert(MipChain::numLevels(5, 8) == 4);
+	assert(MipChain::levelOffset(4, 2, 2) == (8 + 2) * 4);
+
+	// a 2x2 checker of black & white averages out to grey.
+	const uint8_t px[] = {
+		0, 0, 0, 0,   255, 255, 255, 255,
+		255, 255, 255, 255,   0, 0, 0, 0
+	};
+	MipChain m(px, 2, 2);
+	assert(m.getNumLevels() == 2);
+	assert(m.getLevel(1)[0] == 128 && m.getLevel(1)[3] == 128);
+
+	puts("ok");
+}
+
+struct TestVert {
+	float x, y;
+	uint8_t col[4];
+	uint16_t tex[2];
+};
+
+VERTEX_LAYOUT(test_layout, TestVert,
+	VATTR(TestVert, x  , "a_pos", 2),
+	VATTR(TestVert, col, "a_col", 4, ATR_NORM),
+	VATTR(TestVert, tex, "a_tex", 2, ATR_NORM)
+);
+
+void test_vertex_layout(int, char**){
+	static_assert(test_layout.stride == 16, "");
+	static_assert(test_layout_attribs[1].type == GL_UNSIGNED_BYTE, "");
+
+	// should match what "a_pos:2f|a_col:4BN|a_tex:2SN" parses to.
+	ShaderAttribs attrs;
+	test_layout.apply(attrs);
+
+	const ShaderAttribs::Attrib* a = attrs.begin();
+	assert(attrs.end() - a == 3);
+	assert(a[0].name_hash == str_hash("a_pos") && a[0].type == GL_FLOAT && a[0].nelem == 2 && a[0].off == 0);
+	assert(a[1].name_hash == str_hash("a_col") && a[1].off == 8 && a[1].flags == ATR_NORM);
+	assert(a[2].type == GL_UNSIGNED_SHORT && a[2].nelem == 2 && a[2].off == 12);
+
+	puts("ok");
+}
+
+// vertex generation throughput, one push per vertex vs. writing into reserve_append spans.
+void test_vertex_bench(int argc, char** argv){
+	Engine e(argc, argv, "Test");
+	DynamicVertexBuffer buf(test_layout, 0);
+
+	const size_t quads = 1 << 16, rounds = 16;
+
+	auto bench = [&](const char* name, std::function<void(size_t)> gen){
+		const Uint64 start = SDL_GetPerformanceCounter();
+		for(size_t r = 0; r < rounds; ++r){
+			buf.clear();
+			for(size_t i = 0; i < quads; ++i) gen(i);
+		}
+		const double secs = (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+
+		assert(buf.getSize() == quads * 6);
+		printf("%-16s %7.2f Mverts/s\n", name, (quads * 6 * rounds) / secs / 1e6);
+	};
+
+	bench("push", [&](size_t i){
+		for(int j = 0; j < 6; ++j){
+			buf.push(TestVert{ float(i), float(j), { 255, 255, 255, 255 }, { 0, 0 } });
+		}
+	});
+
+	bench("reserve_append", [&](size_t i){
+		BufferSpan<TestVert> v = buf.reserve_append<TestVert>(6);
+		for(int j = 0; j < 6; ++j){
+			v[j] = TestVert{ float(i), float(j), { 255, 255, 255, 255 }, { 0, 0 } };
+		}
+	});
+
+	bench("push_range", [&](size_t i){
+		TestVert v[6];
+		for(int j = 0; j < 6; ++j){
+			v[j] = TestVert{ float(i), float(j), { 255, 255, 255, 255 }, { 0, 0 } };
+		}
+		buf.push_range(std::begin(v), std::end(v));
+	});
+
+	puts("ok");
+}
+
+// checks a deterministic run of the update, then times the CPU side cost of a steady
+// 100k particles: the update, swap-removes and instance writes.
+void test_particle_bench(int argc, char** argv){
+	Engine e(argc, argv, "Test");
+	Resource<VertShader> vs(e, {"particle.glslv"});
+	Resource<FragShader> fs(e, {"particle.glslf"});
+	ShaderProgram shader(vs, fs);
+	Material mat(shader);
+	ParticleSystem ps(e, mat, shader, 1 << 17);
+
+	// with fixed velocities and lifetimes every particle follows the same path, so check
+	// where they end up: v += g*dt then x += v*dt each step, and all dead after their life.
+	{
+		const ParticleEmitter fixed = {
+			{ 100, 100 }, { 30, -60 }, { 30, -60 }, 1.0f, 1.0f, 4.0f, 0xff0000ff, 0.0f, false
+		};
+		const glm::vec2 g(0, 50);
+		const float dt = 0.016f;
+		const int steps = 30;
+
+		ps.setGravity(g);
+		ps.burst(fixed, 20000);
+		for(int i = 0; i < steps; ++i) ps.update(16);
+
+		const float k = steps * (steps + 1) / 2.0f;
+		const glm::vec2 expect = fixed.pos + fixed.vel_min * (steps * dt) + g * (k * dt * dt);
+
+		assert(ps.size() == 20000);
+		for(size_t i = 0; i < ps.size(); ++i){
+			assert(fabsf(ps.p.x[i] - expect.x) < 0.01f && fabsf(ps.p.y[i] - expect.y) < 0.01f);
+			assert(fabsf(ps.p.life[i] - (1.0f - steps * dt)) < 0.001f);
+		}
+
+		// the instance data is rewritten in place, and all of it has to be sent every frame.
+		if(ps.isInstanced()){
+			RenderState rs = {};
+			ps.update(16);
+			ps.instances->update(rs);
+			assert(rs.stats.bytes_uploaded == ps.size() * ps.instances->getStride());
+		}
+
+		for(int i = 0; i < 40; ++i) ps.update(16);
+		assert(ps.size() == 0);
+		ps.setGravity({ 0, 0 });
+	}
+
+	const ParticleEmitter em = {
+		{ 320, 240 }, { -100, -100 }, { 100, 100 }, 0.5f, 4.0f, 4.0f, 0xffffffff, 0.0f, false
+	};
+	const size_t num = 100000, rounds = 240;
+
+	ps.burst(em, num);
+
+	const Uint64 start = SDL_GetPerformanceCounter();
+	for(size_t r = 0; r < rounds; ++r){
+		ps.update(16);
+		// top back up with as many as died.
+		ps.burst(em, num - ps.size());
+	}
+	const double secs = (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+
+	assert(ps.size() == num);
+	printf("%zu particles: %.3f ms per update, %zu worker threads\n", num, secs * 1000.0 / rounds, e.jobs->numThreads());
+
+	puts("ok");
+}
+
+// lists recorded by jobs have to come out in the same order as recording them one by one.
+void test_record_parallel(int argc, char** argv){
+	Engine e(argc, argv, "Test");
+
+	const size_t num_lists = 8, per_list = 64;
+	static const char* labels[] = { "a", "b", "c", "d", "e", "f", "g", "h" };
+	std::vector<Renderable> rs(num_lists * per_list);
+
+	// uneven amounts of work, so the jobs finish in some other order than they started.
+	auto record = [&](size_t i, CommandList& cl){
+		cl.setLabel(labels[i]);
+		for(size_t j = 0; j < per_list; ++j){
+			volatile int spin = ((num_lists - i) * 1000);
+			while(spin > 0) spin = spin - 1;
+			cl.addRenderable(rs[i * per_list + j]);
+		}
+	};
+
+	CommandList serial;
+	for(size_t i = 0; i < num_lists; ++i){
+		record(i, serial);
+	}
+
+	for(int round = 0; round < 32; ++round){
+		e.renderer->recordParallel(num_lists, record);
+
+		const CommandList& merged = e.renderer->getCommandList();
+		assert(merged.size() == serial.size());
+		for(size_t i = 0; i < merged.size(); ++i){
+			assert(merged.begin()[i] == serial.begin()[i]);
+			assert(merged.getLabel(i) == serial.getLabel(i));
+		}
+
+		e.renderer->commands.clear();
+	}
+
+	puts("ok");
+}
+
+// the render thread draws from raw pointers, so destroying what a frame in flight
+// points at has to wait for that frame to finish first.
+void test_threaded_destroy(int argc, char** argv){
+	char opt_threaded[] = "+r_threaded", opt_on[] = "1";
+
+	std::vector<char*> args(argv, argv + argc);
+	args.insert(args.begin() + 1, { opt_threaded, opt_on });
+
+	Engine e(args.size(), args.data(), "Test");
+
+	if(!e.renderer->render_thread){
+		puts("skipped, no render thread");
+		return;
+	}
+
+	Resource<VertShader> vs(e, {"sprite.glslv"});
+	Resource<FragShader> fs(e, {"sprite.glslf"});
+	ShaderProgram shader(vs, fs);
+	assert(shader.link());
+
+	const uint8_t px[] = { 255, 255, 255, 255 };
+
+	for(int i = 0; i < 32; ++i){
+		std::unique_ptr<Texture2D> tex(new Texture2D(GL_UNSIGNED_BYTE, GL_RGBA8, 1, 1, px));
+		Material mat(shader, *tex);
+		std::unique_ptr<SpriteBatch> batch(new SpriteBatch(mat));
+		std::unique_ptr<Sprite> sprite(new Sprite(*batch, { 100, 100 }, { 16, 16 }));
+
+		batch->draw(*e.renderer);
+		e.renderer->drawFrame();
+
+		// the batch's VertexState and buffers, then the texture, go while it may still be drawing.
+		sprite.reset();
+		batch.reset();
+		assert(!e.renderer->pending_frame);
+		tex.reset();
+	}
+
+	e.renderer->waitForFrame();
+	puts("ok");
+}
+
 void test_engine_rendering(int argc, char** argv){
 	Engine e(argc, argv, "Test");
 	TestState ts(e);
@@ -66,6 +626,123 @@ void test_engine_rendering(int argc, char** argv){
 #endif
 }
 
+// draws TestState headless at a fixed timestep, comparing a few frames against the PNGs
+// in data/golden/. A missing one is a failure, mismatches are saved in the user dir as
+// _fail. With GOLDEN_RECORD=1 set, the frames are written to data/golden/ instead.
+void test_golden_images(int argc, char** argv){
+	char opt_headless[] = "--headless", opt_async[] = "+r_tex_async", opt_off[] = "0";
+
+	// before the user's args, so those can override them.
+	std::vector<char*> args(argv, argv + argc);
+	args.insert(args.begin() + 1, { opt_headless, opt_async, opt_off });
+
+	Engine e(args.size(), args.data(), "Test");
+	TestState ts(e);
+
+	e.addState(&ts);
+	e.state->processStateChanges(e);
+	ts.onResize(e, e.renderer->window_w, e.renderer->window_h);
+	e.renderer->setCapture(true);
+
+	const int frames[] = { 1, 60, 120 };
+	const int max_diff = 8;        // per channel.
+	const double max_bad = 0.001;  // fraction of pixels allowed to be further off than that.
+
+	const bool record = getenv("GOLDEN_RECORD") && atoi(getenv("GOLDEN_RECORD"));
+
+	// recorded frames go straight into data/, to be committed.
+	if(record){
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s%sdata", PHYSFS_getBaseDir(), PHYSFS_getDirSeparator());
+		if(!PHYSFS_setWriteDir(path)){
+			printf("Couldn't write to %s: %s\n", path, PHYSFS_getLastError());
+			exit(1);
+		}
+	}
+
+	bool ok = true;
+	int frame = 0;
+
+	for(int target : frames){
+		double cpu_ms = 0.0;
+
+		for(; frame < target; ++frame){
+			e.state->update(e, 16);
+			e.state->draw(*e.renderer);
+
+			const Uint64 start = SDL_GetPerformanceCounter();
+			e.renderer->drawFrame();
+			cpu_ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+		}
+
+		std::vector<uint8_t> pixels, png;
+		int w = 0, h = 0;
+		if(!e.renderer->readPixels(pixels, w, h)){
+			puts("Couldn't read back frame.");
+			exit(1);
+		}
+
+		// destination alpha depends on the driver's blending, and isn't what gets shown anyway.
+		for(size_t i = 3; i < pixels.size(); i += 4){
+			pixels[i] = 255;
+		}
+
+		char name[64], gpu[16] = "n/a";
+		snprintf(name, sizeof(name), "golden/frame_%03d.png", target);
+		if(e.renderer->getGpuFrameMs() > 0.0f){
+			snprintf(gpu, sizeof(gpu), "%.2f ms", e.renderer->getGpuFrameMs());
+		}
+
+		if(record){
+			png_encode(pixels.data(), w, h, png);
+			if(!e.res->saveUserFile(name, MemBlock(png.data(), png.size()))){
+				printf("Couldn't write %s.\n", name);
+				exit(1);
+			}
+
+			printf("%-20s recorded            cpu %6.2f ms  gpu %s\n", name, cpu_ms, gpu);
+			continue;
+		}
+
+		ResourceHandle golden = e.res->load(name);
+		int gw = 0, gh = 0;
+		uint8_t* expected = golden ? stbi_load_from_memory(golden.data(), golden.size(), &gw, &gh, nullptr, 4) : nullptr;
+
+		if(!expected){
+			printf("%-20s MISSING, record it with GOLDEN_RECORD=1\n", name);
+			ok = false;
+			continue;
+		}
+
+		size_t bad = size_t(w) * h;
+		if(gw == w && gh == h){
+			bad = 0;
+			for(size_t i = 0; i < pixels.size(); i += 4){
+				for(int c = 0; c < 3; ++c){
+					if(abs(pixels[i + c] - expected[i + c]) > max_diff){
+						++bad;
+						break;
+					}
+				}
+			}
+		}
+		stbi_image_free(expected);
+
+		const bool pass = bad <= max_bad * w * h;
+		printf("%-20s %s %8zu px off  cpu %6.2f ms  gpu %s\n", name, pass ? "pass" : "FAIL", bad, cpu_ms, gpu);
+
+		if(!pass){
+			snprintf(name, sizeof(name), "golden_%03d_fail.png", target);
+			png_encode(pixels.data(), w, h, png);
+			e.res->saveUserFile(name, MemBlock(png.data(), png.size()));
+			ok = false;
+		}
+	}
+
+	puts(ok ? "ok" : "failed");
+	if(!ok) exit(1);
+}
+
 void test_engine_collision(int argc, char** argv){
 	Engine e(argc, argv, "Test");
 	TestCollisionState ts(e);
@@ -85,9 +762,24 @@ struct Test {
 	const char* name;
 	void (*func)(int, char**);
 } tests[] = {
-	{ "shader-uniforms", &test_shader_uniforms },
-	{ "rendering",       &test_engine_rendering },
-	{ "collision",       &test_engine_collision }
+	{ "shader-uniforms",  &test_shader_uniforms },
+	{ "buffer-alloc",     &test_buffer_alloc },
+	{ "streaming-buffer", &test_streaming_buffer },
+	{ "atlas-packer",     &test_atlas_packer },
+	{ "atlas-array",      &test_atlas_array },
+	{ "globals-block",    &test_globals_block },
+	{ "camera",           &test_camera },
+	{ "tilemap",          &test_tilemap },
+	{ "sprite-culling",   &test_sprite_culling },
+	{ "mip-chain",        &test_mip_chain },
+	{ "vertex-layout",    &test_vertex_layout },
+	{ "vertex-bench",     &test_vertex_bench },
+	{ "particle-bench",   &test_particle_bench },
+	{ "record-parallel",  &test_record_parallel },
+	{ "threaded-destroy", &test_threaded_destroy },
+	{ "rendering",        &test_engine_rendering },
+	{ "golden",           &test_golden_images },
+	{ "collision",        &test_engine_collision }
 };
 
 int main(int argc, char** argv){
@@ -21,10 +21,12 @@ struct TestState : public GameState {
 	, tri_vbo       (vertices, "a_pos:2f|a_col:4BN")
 	, tri_vs        (e, {"test.glslv"})
 	, sprite_vs     (e, {"sprite.glslv"})
+	, sprite_inst_vs(e, {"sprite_instanced.glslv"})
 	, tri_fs        (e, {"test.glslf"})
 	, sprite_fs     (e, {"sprite.glslf"})
 	, tri_shader    (tri_vs, tri_fs)
 	, sprite_shader (sprite_vs, sprite_fs)
+	, sprite_inst_shader(sprite_inst_vs, sprite_fs)
 	, tri_vstate    ()
 	, triangle      (&tri_vstate, &tri_shader, &tri_uniforms, RType{GL_TRIANGLES}, RCount{3})
 	, font          (e, {"LiberationSans-Regular.ttf"}, 64)
@@ -32,15 +34,29 @@ struct TestState : public GameState {
 	, samp_nearest  ({{ GL_TEXTURE_MAG_FILTER, GL_NEAREST }})
 	, sprite_tex    (e, {"test_sprite.png"})
 	, sprite_mat    (sprite_shader, *sprite_tex, samp_nearest)
-	, sprite_batch  (sprite_mat)
+	, sprite_batch  (sprite_mat, sprite_inst_shader)
 	, test_sprite   (sprite_batch, { 200, 200 }, { 64, 64 })
+	, particle_vs   (e, {"particle.glslv"})
+	, particle_fs   (e, {"particle.glslf"})
+	, particle_shader(particle_vs, particle_fs)
+	, particle_mat  (particle_shader)
+	, particles     (e, particle_mat, particle_shader, 4096)
+	, emitter       (nullptr)
 	, center        ({ 320, 240 }){
 		tri_vstate.setVertexBuffers({ &tri_vbo });
+		sprite_batch.setCamera(&e.renderer->getCamera());
+
+		particles.setGravity({ 0.0f, 200.0f });
+		emitter = particles.addEmitter(ParticleEmitter{
+			{ 320, 380 }, { -60, -240 }, { 60, -160 }, 0.5f, 1.5f, 8.0f, 0xffaa33ff, 400.0f, true
+		});
 	}
 
 	bool onInit(Engine& e){
 		tri_shader.link();
 		sprite_shader.link();
+		sprite_inst_shader.link();
+		particle_shader.link();
 
 		return true;
 	}
@@ -69,20 +85,36 @@ struct TestState : public GameState {
 
 		tri_uniforms.setUniform("timer", { 1.0f + tri_timer });
 		test_sprite.setPosition({ center.x + sprite_timer * 200.0f, (center.y + 140.0f) });
+
+		emitter->pos = { center.x + sprite_timer * 200.0f, center.y + 140.0f };
+		particles.update(delta);
 	}
 
 	void draw(Renderer& renderer){
+		renderer.setLabel("triangle");
 		renderer.addRenderable(triangle);
+		renderer.setLabel("text");
 		text.draw(renderer);
-		sprite_batch.draw(renderer);
+
+		// these only write into their own buffers, so they can be recorded side by side.
+		renderer.recordParallel(2, [&](size_t i, CommandList& cl){
+			if(i == 0){
+				cl.setLabel("sprites");
+				sprite_batch.draw(cl);
+			} else {
+				cl.setLabel("particles");
+				particles.draw(cl);
+			}
+		});
+		renderer.setLabel(nullptr);
 	}
 private:
 	unsigned int timer;
 	StaticVertexBuffer tri_vbo;
 
-	Resource<VertShader> tri_vs, sprite_vs;
+	Resource<VertShader> tri_vs, sprite_vs, sprite_inst_vs;
 	Resource<FragShader> tri_fs, sprite_fs;
-	ShaderProgram tri_shader, sprite_shader;
+	ShaderProgram tri_shader, sprite_shader, sprite_inst_shader;
 
 	ShaderUniforms tri_uniforms;
 	VertexState tri_vstate;
@@ -97,6 +129,13 @@ private:
 	SpriteBatch sprite_batch;
 	Sprite test_sprite;
 
+	Resource<VertShader> particle_vs;
+	Resource<FragShader> particle_fs;
+	ShaderProgram particle_shader;
+	Material particle_mat;
+	ParticleSystem particles;
+	ParticleEmitter* emitter;
+
 	glm::ivec2 center;
 };
 